@@ -2,7 +2,14 @@
 #include "pch.h"
 
 #include "GameData.hpp"
+#include "KmerIndex.hpp"
+#include "MatchKernels.hpp"
+#include "PatternSearch.hpp"
+#include "PointerScan.hpp"
+#include "RegionSketch.hpp"
+#include "SuffixArray.hpp"
 #include "Util.hpp"
+#include "WorkStealingPool.hpp"
 
 namespace
 {
@@ -15,17 +22,65 @@ namespace
 	struct Image
 	{
 		std::vector<Region> Regions;
+		std::string Filename; //of the dump, the index is cached next to it
+		std::vector<std::vector<int32_t>> SuffixArrays; //one per region once indexed, see the index command
+		std::vector<RegionSketch> Sketches; //one per region once loaded, see PairRegions
 
 		bool IsEmpty() const
 		{
 			return Regions.empty();
 		}
+
+		//must be called whenever Regions changes
+		void BuildRegionIndex()
+		{
+			_RegionsByBase.clear();
+			_RegionsByAddress.clear();
+			for (std::size_t r = 0; r < Regions.size(); ++r)
+			{
+				_RegionsByBase.emplace(Regions[r].Base, r); //the first of equal bases wins, as with a linear search
+				_RegionsByAddress.push_back(r);
+			}
+			std::stable_sort(_RegionsByAddress.begin(), _RegionsByAddress.end(), [&](std::size_t a, std::size_t b)
+			{
+				return Regions[a].Base < Regions[b].Base;
+			});
+		}
+
+		const Region* FindRegion(int32_t base) const
+		{
+			const auto it = _RegionsByBase.find(base);
+			return it == _RegionsByBase.end() ? nullptr : &Regions[it->second];
+		}
+
+		//the region containing address, regions of a dump don't overlap
+		const Region* FindRegionAt(int64_t address) const
+		{
+			auto it = std::upper_bound(_RegionsByAddress.cbegin(), _RegionsByAddress.cend(), address, [&](int64_t a, std::size_t r)
+			{
+				return a < Regions[r].Base;
+			});
+			if (it == _RegionsByAddress.cbegin())
+				return nullptr;
+			const Region& region = Regions[*--it];
+			return address < region.Base + (int64_t)region.Data.size() ? &region : nullptr;
+		}
+	private:
+		std::unordered_map<int32_t, std::size_t> _RegionsByBase; //index into Regions
+		std::vector<std::size_t> _RegionsByAddress; //indices into Regions sorted by base
 	};
 
 	constexpr uint32_t NoRegionSelected = std::numeric_limits<uint32_t>::max();
+	constexpr std::size_t MaxExactMatchesShown = 100;
+	constexpr std::size_t MaxPartialMatchesStored = 256;
+	constexpr std::size_t MatchChunkSize = 1 << 20; //windows per task when partial matching runs in parallel
+	constexpr std::size_t MaxMessageLocationsStored = 10;
+	constexpr std::size_t MaxMessagePartialsStored = 3;
+	constexpr double MinRegionSimilarity = 0.25; //estimated Jaccard similarity of their shingles for two regions to be paired
 
 	static std::vector<Image> _imageStack;
 	static uint32_t _selectedRegionBase = NoRegionSelected;
+	static MatchKernel _matchKernel = GetDefaultMatchKernel(); //for Hamming scoring, see the kern command
 
 	struct Match
 	{
@@ -40,9 +95,72 @@ namespace
 		}
 	};
 
+	//the best matches seen so far, never more than the capacity
+	//the worst stored match sits on top of a min-heap, so once full the threshold only ever rises
+	class TopMatches
+	{
+	public:
+		explicit TopMatches(std::size_t capacity) : _Capacity(capacity)
+		{
+			_Heap.reserve(capacity);
+		}
+
+		//lowest score Add would still keep
+		int GetThreshold() const
+		{
+			return _Heap.size() < _Capacity ? 1 : _Heap.front().Score + 1;
+		}
+
+		void Add(const Match& match)
+		{
+			if (match.Score < GetThreshold())
+				return;
+
+			if (_Heap.size() == _Capacity)
+			{
+				std::pop_heap(_Heap.begin(), _Heap.end(), IsBetter);
+				_Heap.pop_back();
+			}
+			_Heap.push_back(match);
+			std::push_heap(_Heap.begin(), _Heap.end(), IsBetter);
+		}
+
+		void Merge(const TopMatches& other)
+		{
+			for (const Match& match : other._Heap)
+				Add(match);
+		}
+
+		std::size_t GetSize() const
+		{
+			return _Heap.size();
+		}
+
+		//best first
+		std::vector<Match> GetSorted() const
+		{
+			std::vector<Match> sorted = _Heap;
+			std::sort(sorted.begin(), sorted.end(), IsBetter);
+			return sorted;
+		}
+	private:
+		std::size_t _Capacity;
+		std::vector<Match> _Heap;
+
+		static bool IsBetter(const Match& lhs, const Match& rhs)
+		{
+			return rhs < lhs;
+		}
+	};
+
 	class SequenceMatching
 	{
 	public:
+		//edit distance scoring tolerates bytes inserted into or removed from the sequence, Hamming scoring only counts equal bytes
+		explicit SequenceMatching(bool editDistance = false) : _EditDistance(editDistance)
+		{
+		}
+
 		void TryToMatchSequenceWithRegion(const std::vector<uint8_t>& sequence, const Region& region)
 		{
 			const std::vector<uint8_t>& workBuffer = region.Data;
@@ -72,16 +190,65 @@ namespace
 			TryToMatchSequence(sequence, workBuffer, &fromRegion);
 		}
 
+		//only the windows starting in [begin, end) of workBuffer, so a large buffer can be split across threads
+		void TryToMatchSequenceInChunk(const std::vector<uint8_t>& sequence, const std::vector<uint8_t>& workBuffer, std::size_t begin, std::size_t end,
+			const Region* region)
+		{
+			if (sequence.size() > workBuffer.size() || begin >= end)
+			{
+				return;
+			}
+
+			//windows near the end read past it, and edit distance alignments ending in the chunk may start up to
+			//two sequence lengths earlier, so the kernel is given that much data before too
+			const std::size_t lead = _EditDistance ? std::min(begin, 2 * sequence.size()) : 0;
+			const std::size_t first = begin - lead;
+			const std::size_t last = std::min(workBuffer.size(), end + sequence.size() - 1);
+
+			//kernels skip every window below the threshold, which rises as better matches push out the worst
+			auto report = [&](std::size_t index, int matchScore)
+			{
+				index += first;
+				if (index < begin || index >= end)
+					return _Matches.GetThreshold();
+
+				Match match;
+				match.Score = matchScore;
+				match.Index = (int)index;
+				match.pRegion = region;
+				match.pWorkBuffer = &workBuffer;
+				_Matches.Add(match);
+				return _Matches.GetThreshold();
+			};
+			if (_EditDistance)
+				MatchEditDistance(workBuffer.data() + first, last - first, sequence.data(), sequence.size(), _Matches.GetThreshold(), report);
+			else
+				MatchHamming(_matchKernel, workBuffer.data() + first, last - first, sequence.data(), sequence.size(), _Matches.GetThreshold(), report);
+		}
+
+		//matches of another SequenceMatching of the same sequence, e.g. one that searched other regions on another thread
+		void Merge(SequenceMatching&& other)
+		{
+			_Matches.Merge(other._Matches);
+			for (auto& workBuffer : other._WorkBuffers)
+				_WorkBuffers.push_back(std::move(workBuffer));
+			other._WorkBuffers.clear();
+		}
+
+		//best first
+		std::vector<Match> GetMatches() const
+		{
+			return _Matches.GetSorted();
+		}
+
 		void DisplayMatches(const std::vector<uint8_t>& sequence)
 		{
-			std::cout << _Matches.size() << " partial matches stored\n";
+			std::cout << _Matches.GetSize() << " partial matches stored\n";
 
 			int wrap = 0;
-			while (!_Matches.empty())
+			for (const Match& match : _Matches.GetSorted())
 			{
 				std::cout << std::endl;
-				const Match match = _Matches.top();
-				_Matches.pop();
 
 			RestartMatchEmit:
 				std::cout << "Match at " << match.Index << "[";
@@ -120,61 +287,13 @@ namespace
 			}
 		}
 	private:
-		std::priority_queue<Match> _Matches;
-		int _WorstMatchScore = 0;
-		int _BestMatchScore = 0;
-		int _NumWorst = std::numeric_limits<int>::max();
+		bool _EditDistance;
+		TopMatches _Matches{ MaxPartialMatchesStored };
 		std::vector<std::unique_ptr<std::vector<uint8_t>>> _WorkBuffers;
 
 		void TryToMatchSequence(const std::vector<uint8_t>& sequence, const std::vector<uint8_t>& workBuffer, const Region* region = nullptr)
 		{
-			if (sequence.size() > workBuffer.size())
-			{
-				return;
-			}
-
-			for (int i = 0, n = workBuffer.size() - sequence.size() + 1; i < n; ++i)
-			{
-				int matchScore = 0;
-				for (int j = 0; j < (int)sequence.size(); ++j)
-				{
-					if (workBuffer[i + j] == sequence[j])
-					{
-						matchScore += 1;
-					}
-				}
-
-				if (matchScore > 0)
-				{
-					AddMatch(matchScore, i, &workBuffer, region);
-				}
-			}
-		}
-
-		void AddMatch(int matchScore, int index, const std::vector<uint8_t>* workBuffer, const Region* region = nullptr)
-		{
-			//basic complexity limiter to avoid filling memory like hell
-			//it would be preferable to get rid of worst matches to keep max size, but no point spending el mucho time
-			_BestMatchScore = std::max(_BestMatchScore, matchScore);
-			if (matchScore == _WorstMatchScore)
-			{
-				_NumWorst += 1;
-			}
-			if (matchScore >= _WorstMatchScore && (matchScore < _BestMatchScore || matchScore == 1) && _NumWorst > 25)
-			{
-				_WorstMatchScore += 1;
-				_NumWorst = 0;
-			}
-
-			if (matchScore >= _WorstMatchScore)
-			{
-				Match match;
-				match.Score = matchScore;
-				match.Index = index;
-				match.pRegion = region;
-				match.pWorkBuffer = workBuffer;
-				_Matches.push(match);
-			}
+			TryToMatchSequenceInChunk(sequence, workBuffer, 0, workBuffer.size(), region);
 		}
 
 		template <typename TransformFuncT>
@@ -234,84 +353,191 @@ static void PopImage()
 	_imageStack.pop_back();
 }
 
-static void LoadBinaryFile(const std::string& filename, bool segmented)
+//regions of a plain or segmented dump, false if it could not be opened
+static bool ReadImage(const std::string& filename, bool segmented, Image& image)
 {
-	PushImageIfNeeded();
-
 	std::ifstream is(filename, std::ios::binary);
-	if (is.good())
-	{
-		is.seekg(0, std::ios_base::end);
-		const auto length = is.tellg();
-		is.seekg(0, std::ios_base::beg);
+	if (!is.good())
+		return false;
 
-		if (segmented)
+	is.seekg(0, std::ios_base::end);
+	const auto length = is.tellg();
+	is.seekg(0, std::ios_base::beg);
+
+	if (segmented)
+	{
+		int64_t remaining = static_cast<int64_t>(length);
+		while (remaining > 0)
 		{
-			int64_t remaining = static_cast<int64_t>(length);
-			while (remaining > 0)
+			if (length < 8)
 			{
-				if (length < 8)
-				{
-					std::cerr << "Corrupt region header encountered\n";
-					break;
-				}
-
-				uint32_t regionBase;
-				uint32_t regionLength;
-				is.read(reinterpret_cast<char*>(&regionBase), 4);
-				is.read(reinterpret_cast<char*>(&regionLength), 4);
-				remaining -= 8;
+				std::cerr << "Corrupt region header encountered\n";
+				break;
+			}
 
-				if (regionLength > remaining)
-				{
-					std::cerr << "Corrupt region header encountered\n";
-					break;
-				}
+			uint32_t regionBase;
+			uint32_t regionLength;
+			is.read(reinterpret_cast<char*>(&regionBase), 4);
+			is.read(reinterpret_cast<char*>(&regionLength), 4);
+			remaining -= 8;
 
-				Region newBuffer;
-				newBuffer.Data.resize((std::size_t)regionLength);
-				newBuffer.Base = regionBase;
-				is.read(reinterpret_cast<char*>(&*newBuffer.Data.begin()), regionLength);
+			if (regionLength > remaining)
+			{
+				std::cerr << "Corrupt region header encountered\n";
+				break;
+			}
 
-				_imageStack.back().Regions.push_back(std::move(newBuffer));
+			Region newBuffer;
+			newBuffer.Data.resize((std::size_t)regionLength);
+			newBuffer.Base = regionBase;
+			is.read(reinterpret_cast<char*>(&*newBuffer.Data.begin()), regionLength);
 
-				remaining -= regionLength;
-			}
+			image.Regions.push_back(std::move(newBuffer));
 
-			std::cout << "Loaded " << _imageStack.back().Regions.size() << " regions\n";
+			remaining -= regionLength;
 		}
-		else
+	}
+	else
+	{
+		Region newBuffer;
+		newBuffer.Data.resize((std::size_t)length);
+		is.read(reinterpret_cast<char*>(&*newBuffer.Data.begin()), length);
+
+		image.Regions.push_back(std::move(newBuffer));
+	}
+
+	image.Filename = filename;
+	image.BuildRegionIndex();
+	return true;
+}
+
+static unsigned GetNumThreads()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+//sketch of every region, for pairing them with the regions of other images
+static void SketchRegions(Image& image, unsigned numThreads)
+{
+	std::vector<std::size_t> order(image.Regions.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+	{
+		return image.Regions[a].Data.size() > image.Regions[b].Data.size();
+	});
+
+	image.Sketches.resize(image.Regions.size());
+	WorkStealingPool pool(numThreads);
+	for (std::size_t r : order)
+	{
+		pool.Add([&image, r](unsigned)
 		{
-			Region newBuffer;
-			newBuffer.Data.resize((std::size_t)length);
-			is.read(reinterpret_cast<char*>(&*newBuffer.Data.begin()), length);
+			image.Sketches[r] = ComputeRegionSketch(image.Regions[r].Data.data(), image.Regions[r].Data.size());
+		});
+	}
+	pool.Run();
+}
 
-			_imageStack.back().Regions.push_back(std::move(newBuffer));
-		}
+static void LoadBinaryFile(const std::string& filename, bool segmented)
+{
+	PushImageIfNeeded();
+
+	Image& image = _imageStack.back();
+	if (ReadImage(filename, segmented, image))
+	{
+		SketchRegions(image, GetNumThreads());
+
+		std::size_t length = 0;
+		for (const Region& region : image.Regions)
+			length += region.Data.size();
 
+		if (segmented)
+			std::cout << "Loaded " << image.Regions.size() << " regions\n";
 		std::cout << "Loaded " << length << " bytes\n";
 	}
 	else
 	{
 		std::cerr << "No such file\n";
 	}
-	is.close();
 }
 
-static std::vector<uint8_t> GetByteSequenceFromDescription(const std::string& description)
+//decimal, or hexadecimal with a 0x prefix
+static bool ParseByte(const std::string& text, uint8_t& value)
 {
-	std::vector<uint8_t> sequence;
+	const bool hex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+	const std::string digits = hex ? text.substr(2) : text;
+	if (digits.empty() || digits.size() > 3 || !std::all_of(digits.cbegin(), digits.cend(), [&](char c)
+	{
+		return hex ? std::isxdigit(c) : std::isdigit(c);
+	}))
+	{
+		return false;
+	}
+
+	const unsigned long parsed = std::strtoul(digits.c_str(), nullptr, hex ? 16 : 10);
+	if (parsed > 255)
+		return false;
+	value = static_cast<uint8_t>(parsed);
+	return true;
+}
+
+//byte, wildcard, range or masked element, e.g. 0x41 or ?? or 75-91 or 0x40&0xF0 (bits of the value under the mask),
+//false for anything else
+static bool ParsePatternElement(const std::string& token, PatternByte& element)
+{
+	uint8_t lhs;
+	uint8_t rhs;
+	if (ParseByte(token, lhs))
+	{
+		element = { 0xFF, lhs, lhs };
+		return true;
+	}
+	if (token == "??")
+	{
+		element = { 0, 0, 0 };
+		return true;
+	}
+	const auto dash = token.find('-');
+	if (dash != std::string::npos && ParseByte(token.substr(0, dash), lhs) && ParseByte(token.substr(dash + 1), rhs))
+	{
+		element = { 0xFF, std::min(lhs, rhs), std::max(lhs, rhs) };
+		return true;
+	}
+	const auto ampersand = token.find('&');
+	if (ampersand != std::string::npos && ParseByte(token.substr(0, ampersand), lhs) && ParseByte(token.substr(ampersand + 1), rhs))
+	{
+		element = { rhs, static_cast<uint8_t>(lhs & rhs), static_cast<uint8_t>(lhs & rhs) };
+		return true;
+	}
+	return false;
+}
+
+static std::vector<PatternByte> GetBytePatternFromDescription(const std::string& description)
+{
+	std::vector<PatternByte> pattern;
 	constexpr char separator = ' ';
 	Split(description.c_str(), separator, [&](const char* data, std::size_t len)
 	{
-		uint8_t nextValue = 0;
-
 		const bool isString = data[0] == '"';
 		if (isString)
 		{
 			data += 1;
 			len -= 1;
 		}
+		else
+		{
+			//like atoi below, pattern elements are read up to the separator
+			const char* end = data;
+			while (*end && *end != separator)
+				++end;
+			PatternByte element;
+			if (ParsePatternElement(std::string(data, end), element))
+			{
+				pattern.push_back(element);
+				return;
+			}
+		}
 
 		bool allDigits = true;
 		for (int i = 0; i < (int)len; ++i)
@@ -339,13 +565,41 @@ static std::vector<uint8_t> GetByteSequenceFromDescription(const std::string& de
 		{
 			for (int i = 0; i < (int)len; ++i)
 			{
-				sequence.push_back(static_cast<uint8_t>(data[i]));
+				const uint8_t value = static_cast<uint8_t>(data[i]);
+				pattern.push_back({ 0xFF, value, value });
 			}
 		}
 		else if (allDigits)
-			sequence.push_back(atoi(data));
+		{
+			const uint8_t value = static_cast<uint8_t>(atoi(data));
+			pattern.push_back({ 0xFF, value, value });
+		}
+	});
+
+	return pattern;
+}
+
+static bool IsLiteral(const std::vector<PatternByte>& pattern)
+{
+	return std::all_of(pattern.cbegin(), pattern.cend(), [](const PatternByte& element)
+	{
+		return element.IsLiteral();
 	});
+}
+
+//searches that score bytes need every byte given
+static std::vector<uint8_t> GetByteSequenceFromDescription(const std::string& description)
+{
+	const std::vector<PatternByte> pattern = GetBytePatternFromDescription(description);
+	if (!IsLiteral(pattern))
+	{
+		std::cout << "Wildcards, ranges and masks are only supported by finds and finde\n";
+		return {};
+	}
 
+	std::vector<uint8_t> sequence;
+	for (const PatternByte& element : pattern)
+		sequence.push_back(element.Lo);
 	return sequence;
 }
 
@@ -364,10 +618,7 @@ static void SelectRegion(const std::string& description)
 	{
 		const uint32_t addr = static_cast<uint32_t>(std::atoll(description.c_str()));
 
-		if (ContainsIf(_imageStack.back().Regions, [&](const Region& region)
-		{
-			return region.Base == addr;
-		}))
+		if (_imageStack.back().FindRegion(static_cast<int32_t>(addr)))
 		{
 			_selectedRegionBase = addr;
 			std::cout << "Selected region\n";
@@ -383,84 +634,410 @@ static void SelectRegion(const std::string& description)
 	}
 }
 
-static void FindSequence(const std::string& description)
+//every region is cut into chunks of windows so a single huge heap region still keeps all threads busy,
+//each thread keeps its own best matches and they are merged at the end
+static SequenceMatching MatchInParallel(const std::vector<uint8_t>& sequence, const std::vector<const Region*>& regions, bool editDistance,
+	unsigned numThreads)
 {
-	if (_imageStack.empty())
-		return;
+	WorkStealingPool pool(numThreads);
+	std::vector<SequenceMatching> workers;
+	for (unsigned i = 0; i < pool.GetNumWorkers(); ++i)
+		workers.emplace_back(editDistance);
 
-	const std::vector<uint8_t> sequence = GetByteSequenceFromDescription(description);
+	for (const Region* region : regions)
+	{
+		const std::vector<uint8_t>& workBuffer = region->Data;
+		for (std::size_t begin = 0; begin + sequence.size() <= workBuffer.size(); begin += MatchChunkSize)
+		{
+			const std::size_t end = std::min(begin + MatchChunkSize, workBuffer.size());
+			pool.Add([&, region, begin, end](unsigned worker)
+			{
+				workers[worker].TryToMatchSequenceInChunk(sequence, region->Data, begin, end, region);
+			});
+		}
+	}
+	pool.Run();
 
-	//for now, do naive O(_workBuffer.size() * sequence.size()) version. optimize if needed
+	SequenceMatching matching(editDistance);
+	for (SequenceMatching& worker : workers)
+		matching.Merge(std::move(worker));
+	return matching;
+}
 
-	SequenceMatching matching;
-	for (const Region& region : _imageStack.back().Regions)
+//index and region base of the first maxStored windows matching pattern, in address order per region, returns how many match in total
+//chunks of every region are searched in parallel like MatchInParallel does
+static std::size_t FindPatternMatches(const std::vector<const Region*>& regions, const std::vector<PatternByte>& pattern, std::size_t maxStored,
+	unsigned numThreads, std::vector<std::pair<int32_t, int32_t>>& matches)
+{
+	struct Chunk
 	{
-		const std::vector<uint8_t>& workBuffer = region.Data;
+		const Region* pRegion;
+		std::size_t Begin;
+		std::size_t End;
+		std::vector<int32_t> Indices; //at most maxStored
+		std::size_t NumMatches;
+	};
+	std::vector<Chunk> chunks;
+	for (const Region* region : regions)
+	{
+		for (std::size_t begin = 0; begin + pattern.size() <= region->Data.size(); begin += MatchChunkSize)
+			chunks.push_back({ region, begin, std::min(begin + MatchChunkSize, region->Data.size()), {}, 0 });
+	}
 
-		if (_selectedRegionBase != NoRegionSelected && _selectedRegionBase != region.Base)
+	WorkStealingPool pool(numThreads);
+	for (Chunk& chunk : chunks)
+	{
+		pool.Add([&](unsigned)
 		{
-			continue;
-		}
+			const std::vector<uint8_t>& data = chunk.pRegion->Data;
+			const std::size_t last = std::min(data.size(), chunk.End + pattern.size() - 1);
+			FindPattern(data.data() + chunk.Begin, last - chunk.Begin, pattern.data(), pattern.size(), [&](std::size_t index)
+			{
+				if (chunk.Indices.size() < maxStored)
+					chunk.Indices.push_back(static_cast<int32_t>(chunk.Begin + index));
+				++chunk.NumMatches;
+				return true;
+			});
+		});
+	}
+	pool.Run();
 
-		matching.TryToMatchSequenceWithRegion(sequence, region);
+	std::size_t numMatches = 0;
+	for (const Chunk& chunk : chunks)
+	{
+		for (std::size_t i = 0; i < chunk.Indices.size() && matches.size() < maxStored; ++i)
+			matches.emplace_back(chunk.Indices[i], chunk.pRegion->Base);
+		numMatches += chunk.NumMatches;
 	}
-	
-	matching.DisplayMatches(sequence);
+	return numMatches;
 }
 
-template <typename T>
-static void EmitCharacter(T c, bool ascii)
+static std::vector<const Region*> GetSelectedRegions(const Image& image, uint32_t selectedRegionBase)
 {
-	if (ascii)
+	std::vector<const Region*> regions;
+	if (selectedRegionBase != NoRegionSelected)
 	{
-		if (c < 32)
-			c = '_';
-		std::cout << c << " ";
+		if (const Region* region = image.FindRegion(static_cast<int32_t>(selectedRegionBase)))
+			regions.push_back(region);
+		return regions;
 	}
-	else
+
+	for (const Region& region : image.Regions)
+		regions.push_back(&region);
+	return regions;
+}
+
+//index and region base of every occurrence of sequence, in address order per region, the image must be indexed
+static std::vector<std::pair<int32_t, int32_t>> FindExactMatches(const Image& image, uint32_t selectedRegionBase, const std::vector<uint8_t>& sequence)
+{
+	std::vector<std::pair<int32_t, int32_t>> matches;
+	for (std::size_t r = 0; r < image.Regions.size(); ++r)
 	{
-		std::cout << (int)c << " ";
+		const Region& region = image.Regions[r];
+		if (selectedRegionBase != NoRegionSelected && selectedRegionBase != region.Base)
+			continue;
+
+		const std::vector<int32_t>& sa = image.SuffixArrays[r];
+		const auto range = FindInSuffixArray(region.Data.data(), region.Data.size(), sa, sequence.data(), sequence.size());
+		std::vector<int32_t> indices(sa.begin() + range.first, sa.begin() + range.second);
+		std::sort(indices.begin(), indices.end());
+		for (int32_t index : indices)
+			matches.emplace_back(index, region.Base);
 	}
+	return matches;
 }
 
-template<typename RegionPointerT>
-static dtl::Diff<uint8_t> CalcDiffsOfRegion(RegionPointerT sourceRegion, RegionPointerT targetRegion)
+static bool IsIndexed(const Image& image)
 {
-	dtl::Diff<uint8_t> diff(sourceRegion->Data, targetRegion->Data);
-	diff.enableHuge();
-	diff.compose();
-	diff.composeUnifiedHunks();
-
-	return diff;
+	return image.SuffixArrays.size() == image.Regions.size();
 }
 
-static void ShowDataDiffs(bool ascii)
+static void FindSequence(const std::string& description, bool editDistance)
 {
-	if (_imageStack.size() < 2)
+	if (_imageStack.empty())
 		return;
 
-	if (_selectedRegionBase == NoRegionSelected)
+	const std::vector<PatternByte> pattern = GetBytePatternFromDescription(description);
+	if (pattern.empty())
+		return;
+
+	//patterns are only matched exactly, and without the index since it can't skip wildcards
+	const Image& image = _imageStack.back();
+	if (!IsLiteral(pattern))
 	{
-		std::cout << "Must have selected a region to do this\n";
+		std::vector<std::pair<int32_t, int32_t>> matches;
+		const std::size_t numMatches = FindPatternMatches(GetSelectedRegions(image, _selectedRegionBase), pattern, MaxExactMatchesShown,
+			GetNumThreads(), matches);
+		for (const auto& match : matches)
+			std::cout << "Match at " << match.first << "[" << match.second << "]\n";
+		std::cout << numMatches << " pattern matches\n";
+		return;
 	}
 
-	const auto& regionsOfTarget = _imageStack.back().Regions;
-	const auto targetRegion = std::find_if(regionsOfTarget.cbegin(), regionsOfTarget.cend(), [](const Region& r)
-	{
-		return r.Base == _selectedRegionBase;
-	});
-	const auto& regionsOfSource = _imageStack[_imageStack.size() - 2].Regions;
-	const auto sourceRegion = std::find_if(regionsOfSource.cbegin(), regionsOfSource.cend(), [](const Region& r)
+	//exact matches straight from the index when there is one, the partial matching below is only needed without any
+	const std::vector<uint8_t> sequence = GetByteSequenceFromDescription(description);
+	if (IsIndexed(image))
 	{
-		return r.Base == _selectedRegionBase;
-	});
+		const auto matches = FindExactMatches(image, _selectedRegionBase, sequence);
+		for (std::size_t i = 0; i < matches.size() && i < MaxExactMatchesShown; ++i)
+			std::cout << "Match at " << matches[i].first << "[" << matches[i].second << "]\n";
+		std::cout << matches.size() << " exact matches\n";
+		if (!matches.empty())
+			return;
+	}
 
-	std::cout << "Size source/target: " << sourceRegion->Data.size() << "/" << targetRegion->Data.size() << std::endl;
+	//partial matching, O(_workBuffer.size() * sequence.size() / 64)
 
-	const auto diff = CalcDiffsOfRegion(sourceRegion, targetRegion);
+	SequenceMatching matching = MatchInParallel(sequence, GetSelectedRegions(image, _selectedRegionBase), editDistance, GetNumThreads());
+	
+	matching.DisplayMatches(sequence);
+}
 
-	for (const auto& hunk : diff.getUniHunks())
-	{
+static const char SuffixArrayMagic[4] = { 'B', 'X', 'S', 'A' };
+
+static std::string GetIndexFilename(const Image& image)
+{
+	return image.Filename + ".sa";
+}
+
+static int64_t GetDumpTime(const std::string& filename)
+{
+	std::error_code error;
+	return std::experimental::filesystem::last_write_time(filename, error).time_since_epoch().count();
+}
+
+//the cache is only used if the dump is unchanged since it was written and splits into the same regions
+static bool LoadIndex(Image& image)
+{
+	std::ifstream is(GetIndexFilename(image), std::ios::binary);
+	char magic[sizeof(SuffixArrayMagic)];
+	int64_t dumpTime;
+	uint32_t numRegions;
+	if (!is.read(magic, sizeof(magic)) || std::memcmp(magic, SuffixArrayMagic, sizeof(magic)) != 0)
+		return false;
+	if (!is.read(reinterpret_cast<char*>(&dumpTime), sizeof(dumpTime)) || dumpTime != GetDumpTime(image.Filename))
+		return false;
+	if (!is.read(reinterpret_cast<char*>(&numRegions), sizeof(numRegions)) || numRegions != image.Regions.size())
+		return false;
+
+	std::vector<std::vector<int32_t>> suffixArrays(numRegions);
+	for (uint32_t r = 0; r < numRegions; ++r)
+	{
+		int32_t base;
+		uint32_t size;
+		if (!is.read(reinterpret_cast<char*>(&base), sizeof(base)) || !is.read(reinterpret_cast<char*>(&size), sizeof(size)))
+			return false;
+		if (base != image.Regions[r].Base || size != image.Regions[r].Data.size())
+			return false;
+
+		suffixArrays[r].resize(size);
+		if (!is.read(reinterpret_cast<char*>(suffixArrays[r].data()), size * sizeof(int32_t)))
+			return false;
+	}
+	image.SuffixArrays = std::move(suffixArrays);
+	return true;
+}
+
+static void SaveIndex(const Image& image)
+{
+	std::ofstream os(GetIndexFilename(image), std::ios::binary);
+	const int64_t dumpTime = GetDumpTime(image.Filename);
+	const uint32_t numRegions = static_cast<uint32_t>(image.Regions.size());
+	os.write(SuffixArrayMagic, sizeof(SuffixArrayMagic));
+	os.write(reinterpret_cast<const char*>(&dumpTime), sizeof(dumpTime));
+	os.write(reinterpret_cast<const char*>(&numRegions), sizeof(numRegions));
+	for (std::size_t r = 0; r < image.Regions.size(); ++r)
+	{
+		const int32_t base = image.Regions[r].Base;
+		const uint32_t size = static_cast<uint32_t>(image.Regions[r].Data.size());
+		os.write(reinterpret_cast<const char*>(&base), sizeof(base));
+		os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		os.write(reinterpret_cast<const char*>(image.SuffixArrays[r].data()), size * sizeof(int32_t));
+	}
+	if (!os)
+		std::cerr << "Failed to write " << GetIndexFilename(image) << std::endl;
+}
+
+//suffix array of every region, one region per thread with the largest handed out first
+static void BuildSuffixArrays(Image& image, unsigned numThreads)
+{
+	std::vector<std::size_t> order(image.Regions.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+	{
+		return image.Regions[a].Data.size() > image.Regions[b].Data.size();
+	});
+
+	std::vector<std::vector<int32_t>> suffixArrays(image.Regions.size());
+	std::atomic<std::size_t> next(0);
+	auto work = [&]()
+	{
+		for (std::size_t i; (i = next++) < order.size(); )
+		{
+			const Region& region = image.Regions[order[i]];
+			suffixArrays[order[i]] = BuildSuffixArray(region.Data.data(), region.Data.size());
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < numThreads; ++i)
+		threads.emplace_back(work);
+	work();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	image.SuffixArrays = std::move(suffixArrays);
+}
+
+//indexes the top image, or loads the index cached next to its dump
+static void BuildIndex()
+{
+	if (_imageStack.empty() || _imageStack.back().IsEmpty())
+		return;
+
+	Image& image = _imageStack.back();
+	const auto start = std::chrono::high_resolution_clock::now();
+	if (LoadIndex(image))
+	{
+		const std::chrono::duration<double> loadTime = std::chrono::high_resolution_clock::now() - start;
+		std::cout << "Loaded index from " << GetIndexFilename(image) << " in " << loadTime.count() << " s\n";
+		return;
+	}
+
+	BuildSuffixArrays(image, GetNumThreads());
+	const std::chrono::duration<double> buildTime = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "Indexed " << image.Regions.size() << " regions in " << buildTime.count() << " s\n";
+	if (!image.Filename.empty())
+		SaveIndex(image);
+}
+
+template <typename T>
+static void EmitCharacter(T c, bool ascii)
+{
+	if (ascii)
+	{
+		if (c < 32)
+			c = '_';
+		std::cout << c << " ";
+	}
+	else
+	{
+		std::cout << (int)c << " ";
+	}
+}
+
+template<typename RegionPointerT>
+static dtl::Diff<uint8_t> CalcDiffsOfRegion(RegionPointerT sourceRegion, RegionPointerT targetRegion)
+{
+	dtl::Diff<uint8_t> diff(sourceRegion->Data, targetRegion->Data);
+	diff.enableHuge();
+	diff.compose();
+	diff.composeUnifiedHunks();
+
+	return diff;
+}
+
+//regions of source and target holding the same data, paired by content so they still line up when CC3 allocated its heaps
+//in a different order, nullptr for a region with no counterpart
+//regions without a similar enough counterpart, e.g. mostly zeroes, fall back to being paired by equal base
+static std::vector<std::pair<const Region*, const Region*>> PairRegions(const Image& source, const Image& target)
+{
+	struct Candidate
+	{
+		std::size_t Source;
+		std::size_t Target;
+		double Similarity;
+		bool SameBase;
+	};
+	std::vector<Candidate> candidates;
+	if (source.Sketches.size() == source.Regions.size() && target.Sketches.size() == target.Regions.size())
+	{
+		for (const auto& pair : FindSimilarSketchCandidates(source.Sketches, target.Sketches))
+		{
+			const double similarity = EstimateSimilarity(source.Sketches[pair.first], target.Sketches[pair.second]);
+			if (similarity >= MinRegionSimilarity)
+				candidates.push_back({ pair.first, pair.second, similarity, source.Regions[pair.first].Base == target.Regions[pair.second].Base });
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs)
+	{
+		return lhs.Similarity > rhs.Similarity || (lhs.Similarity == rhs.Similarity && lhs.SameBase && !rhs.SameBase);
+	});
+
+	//most similar first
+	std::vector<std::pair<const Region*, const Region*>> pairs;
+	std::vector<bool> sourcePaired(source.Regions.size(), false);
+	std::vector<bool> targetPaired(target.Regions.size(), false);
+	for (const Candidate& candidate : candidates)
+	{
+		if (sourcePaired[candidate.Source] || targetPaired[candidate.Target])
+			continue;
+		sourcePaired[candidate.Source] = true;
+		targetPaired[candidate.Target] = true;
+		pairs.emplace_back(&source.Regions[candidate.Source], &target.Regions[candidate.Target]);
+	}
+
+	for (std::size_t s = 0; s < source.Regions.size(); ++s)
+	{
+		if (sourcePaired[s])
+			continue;
+
+		const Region* region = target.FindRegion(source.Regions[s].Base);
+		const std::size_t t = region ? region - target.Regions.data() : 0;
+		if (region && !targetPaired[t])
+		{
+			sourcePaired[s] = true;
+			targetPaired[t] = true;
+			pairs.emplace_back(&source.Regions[s], region);
+		}
+	}
+	for (std::size_t s = 0; s < source.Regions.size(); ++s)
+	{
+		if (!sourcePaired[s])
+			pairs.emplace_back(&source.Regions[s], nullptr);
+	}
+	for (std::size_t t = 0; t < target.Regions.size(); ++t)
+	{
+		if (!targetPaired[t])
+			pairs.emplace_back(nullptr, &target.Regions[t]);
+	}
+	return pairs;
+}
+
+static void ShowDataDiffs(bool ascii)
+{
+	if (_imageStack.size() < 2)
+		return;
+
+	if (_selectedRegionBase == NoRegionSelected)
+	{
+		std::cout << "Must have selected a region to do this\n";
+		return;
+	}
+
+	//the selected region of the top image against whichever region of the one below holds the same data
+	const auto pairs = PairRegions(_imageStack[_imageStack.size() - 2], _imageStack.back());
+	const auto pair = std::find_if(pairs.cbegin(), pairs.cend(), [](const std::pair<const Region*, const Region*>& p)
+	{
+		return p.second && p.second->Base == _selectedRegionBase;
+	});
+	if (pair == pairs.cend() || !pair->first)
+	{
+		std::cout << "Selected region has no counterpart in the previous image\n";
+		return;
+	}
+	const Region* sourceRegion = pair->first;
+	const Region* targetRegion = pair->second;
+	if (sourceRegion->Base != targetRegion->Base)
+		std::cout << "Paired with region at " << sourceRegion->Base << " by content\n";
+
+	std::cout << "Size source/target: " << sourceRegion->Data.size() << "/" << targetRegion->Data.size() << std::endl;
+
+	const auto diff = CalcDiffsOfRegion(sourceRegion, targetRegion);
+
+	for (const auto& hunk : diff.getUniHunks())
+	{
 		std::cout << "@@"
 			<< " -" << hunk.a << "," << hunk.b
 			<< " +" << hunk.c << "," << hunk.d
@@ -505,7 +1082,8 @@ static void ShowDataDiffs(bool ascii)
 	}
 }
 
-static void FindSequenceInDiffOfRegion(SequenceMatching& matching, const std::vector<uint8_t>& sequence, const Region& source, const Region& target)
+//false if either region is too large to diff, runs on pool workers so it leaves reporting that to the caller
+static bool FindSequenceInDiffOfRegion(SequenceMatching& matching, const std::vector<uint8_t>& sequence, const Region& source, const Region& target)
 {
 	if (source.Data.size() == 0)
 		matching.TryToMatchSequenceWithRegion(sequence, target);
@@ -513,24 +1091,15 @@ static void FindSequenceInDiffOfRegion(SequenceMatching& matching, const std::ve
 		matching.TryToMatchSequenceWithRegion(sequence, source);
 	else
 	{
-		assert(source.Base == target.Base);
-
 		constexpr int maxSize = 3000000;
-		if (source.Data.size() > maxSize)
-		{
-			std::cout << "Too large region to diff: " << source.Data.size() << std::endl;
-			return;
-		}
-		if (target.Data.size() > maxSize)
-		{
-			std::cout << "Too large region to diff: " << target.Data.size() << std::endl;
-			return;
-		}
+		if (source.Data.size() > maxSize || target.Data.size() > maxSize)
+			return false;
 
 		const auto diff = CalcDiffsOfRegion(&source, &target);
 
 		matching.TryToMatchSequenceWithDiff(sequence, diff, source);
 	}
+	return true;
 }
 
 static void FindSequenceInDiffsOfAllRegions(const std::string& description)
@@ -538,42 +1107,46 @@ static void FindSequenceInDiffsOfAllRegions(const std::string& description)
 	if (_imageStack.size() < 2)
 		return;
 
+	//wildcards and the like were already reported, nothing to match then
 	const std::vector<uint8_t> sequence = GetByteSequenceFromDescription(description);
+	if (sequence.empty())
+		return;
 
-	const std::vector<Region>& regionsOfTarget = _imageStack.back().Regions;
-	const std::vector<Region>& regionsOfSource = _imageStack[_imageStack.size() - 2].Regions;
-
+	//every region pair is diffed and matched as its own task, largest first since diffing is far from linear
 	const static Region emptyRegion;
-	SequenceMatching matching;
+	std::vector<std::pair<const Region*, const Region*>> pairs;
+	for (const auto& pair : PairRegions(_imageStack[_imageStack.size() - 2], _imageStack.back()))
+	{
+		pairs.emplace_back(pair.first ? pair.first : &emptyRegion, pair.second ? pair.second : &emptyRegion);
+	}
+	std::sort(pairs.begin(), pairs.end(), [](const std::pair<const Region*, const Region*>& lhs, const std::pair<const Region*, const Region*>& rhs)
+	{
+		return lhs.first->Data.size() + lhs.second->Data.size() > rhs.first->Data.size() + rhs.second->Data.size();
+	});
 
-	for (const Region& region : regionsOfSource)
+	WorkStealingPool pool(GetNumThreads());
+	std::vector<SequenceMatching> workers(pool.GetNumWorkers());
+	std::vector<std::vector<std::pair<const Region*, const Region*>>> skipped(pool.GetNumWorkers());
+	for (const auto& pair : pairs)
 	{
-		const auto it = std::find_if(regionsOfTarget.cbegin(), regionsOfTarget.cend(), [&](const Region& other)
+		pool.Add([&, pair](unsigned worker)
 		{
-			return other.Base == region.Base;
+			if (!FindSequenceInDiffOfRegion(workers[worker], sequence, *pair.first, *pair.second))
+				skipped[worker].push_back(pair);
 		});
-
-		if (it == regionsOfTarget.cend())
-		{
-			FindSequenceInDiffOfRegion(matching, sequence, region, emptyRegion);
-		}
-		else
-		{
-			FindSequenceInDiffOfRegion(matching, sequence, region, *it);
-		}
 	}
-	for (const Region& region : regionsOfTarget)
+	pool.Run();
+
+	for (const auto& worker : skipped)
 	{
-		const bool found = ContainsIf(regionsOfSource, [&](const Region& other)
-		{
-			return other.Base == region.Base;
-		});
-		if (!found)
-		{
-			FindSequenceInDiffOfRegion(matching, sequence, emptyRegion, region);
-		}
+		for (const auto& pair : worker)
+			std::cout << "Too large region to diff: " << std::max(pair.first->Data.size(), pair.second->Data.size()) << std::endl;
 	}
 
+	SequenceMatching matching;
+	for (SequenceMatching& worker : workers)
+		matching.Merge(std::move(worker));
+
 	matching.DisplayMatches(sequence);
 }
 
@@ -614,45 +1187,853 @@ static void ShowRegion(const Region& region)
 	}
 }
 
+//regions that were added or removed, or moved to another base, between the previous and the top image
 static void FindRegionDiffs()
 {
 	if (_imageStack.size() < 2)
 		return;
 
-	const std::vector<Region>& regionsOfTarget = _imageStack.back().Regions;
-	const std::vector<Region>& regionsOfSource = _imageStack[_imageStack.size() - 2].Regions;
+	for (const auto& pair : PairRegions(_imageStack[_imageStack.size() - 2], _imageStack.back()))
+	{
+		if (!pair.second)
+		{
+			std::cout << "Region at " << pair.first->Base << " does not exist in new" << std::endl;
+			ShowRegion(*pair.first);
+		}
+		else if (!pair.first)
+		{
+			std::cout << "Region at " << pair.second->Base << " does not exist in old" << std::endl;
+			ShowRegion(*pair.second);
+		}
+		else if (pair.first->Base != pair.second->Base)
+		{
+			std::cout << "Region at " << pair.first->Base << " moved to " << pair.second->Base << std::endl;
+		}
+	}
+}
+
+namespace
+{
+	struct FieldInfo
+	{
+		const char* Name;
+		std::size_t Offset;
+		std::size_t Size;
+	};
+
+#define FIELD(type, field) { #field, offsetof(type, field), sizeof(type::field) }
+	const FieldInfo _soldierFields[] =
+	{
+		FIELD(SoldierData, Index),
+		FIELD(SoldierData, Something),
+		FIELD(SoldierData, IsGerman),
+		FIELD(SoldierData, MustBeZero2),
+		FIELD(SoldierData, Name),
+		FIELD(SoldierData, Field1),
+		FIELD(SoldierData, Field2),
+		FIELD(SoldierData, Unknown),
+	};
+	const FieldInfo _vehicleFields[] =
+	{
+		FIELD(VehicleData, Index),
+		FIELD(VehicleData, Something),
+		FIELD(VehicleData, IsGerman),
+		FIELD(VehicleData, MustBeZero2),
+		FIELD(VehicleData, Name),
+		FIELD(VehicleData, Type),
+		FIELD(VehicleData, Unknown),
+	};
+	const FieldInfo _teamFields[] =
+	{
+		FIELD(TeamData, Index),
+		FIELD(TeamData, Something),
+		FIELD(TeamData, IsGerman),
+		FIELD(TeamData, MustBeZero2),
+		FIELD(TeamData, Name),
+		FIELD(TeamData, Type),
+		FIELD(TeamData, MustBeZero1),
+		FIELD(TeamData, Soldiers),
+		FIELD(TeamData, VehicleIndex),
+		FIELD(TeamData, Unknown),
+	};
+#undef FIELD
+
+	struct ArrayInfo
+	{
+		const char* Side;
+		const char* Name;
+		std::size_t Offset; //within BattleFileData
+		std::size_t RecordSize;
+		int Count;
+		const FieldInfo* Fields;
+		std::size_t NumFields;
+	};
 
-	auto checkForAdditions = [](const std::vector<Region>& a, const std::vector<Region>& b, const char* doesNotExistIn)
+#define ARRAY(side, name, fields) { #side, #name, offsetof(BattleFileData, side##name), sizeof(BattleFileData::side##name[0]), \
+	(int)(sizeof(BattleFileData::side##name) / sizeof(BattleFileData::side##name[0])), fields, sizeof(fields) / sizeof(fields[0]) }
+	const ArrayInfo _battleArrays[] =
 	{
-		for (const Region& region : a)
+		ARRAY(Russian, Soldiers, _soldierFields),
+		ARRAY(Russian, Vehicles, _vehicleFields),
+		ARRAY(Russian, Teams, _teamFields),
+		ARRAY(German, Soldiers, _soldierFields),
+		ARRAY(German, Vehicles, _vehicleFields),
+		ARRAY(German, Teams, _teamFields),
+	};
+#undef ARRAY
+}
+
+//bytes [address, address + size) of an image, nullptr unless they are all inside one region
+static const uint8_t* GetImageBytes(const Image& image, int64_t address, std::size_t size)
+{
+	const Region* region = image.FindRegionAt(address);
+	if (region && address + (int64_t)size <= region->Base + (int64_t)region->Data.size())
+		return region->Data.data() + (address - region->Base);
+	return nullptr;
+}
+
+static const FieldInfo& FindField(const ArrayInfo& array, std::size_t offset)
+{
+	std::size_t i = array.NumFields - 1;
+	while (i > 0 && array.Fields[i].Offset > offset)
+		--i;
+	return array.Fields[i];
+}
+
+//BattleFileData layout overlaid on the two top images at address (0 for battle files loaded with loadb)
+//records are compared a word at a time, every run of changed bytes is reported with the field it falls in
+static void ShowTypedDiffs(const std::string& arg)
+{
+	if (_imageStack.size() < 2)
+		return;
+
+	const int64_t address = arg.empty() ? 0 : std::strtoll(arg.c_str(), nullptr, 0);
+	const Image& source = _imageStack[_imageStack.size() - 2];
+	const Image& target = _imageStack.back();
+
+	int numChanges = 0;
+	for (const ArrayInfo& array : _battleArrays)
+	{
+		const std::size_t arraySize = array.RecordSize * array.Count;
+		const uint8_t* const before = GetImageBytes(source, address + array.Offset, arraySize);
+		const uint8_t* const after = GetImageBytes(target, address + array.Offset, arraySize);
+		if (!before || !after)
+		{
+			std::cout << array.Side << ' ' << array.Name << " not inside a region of both images\n";
+			continue;
+		}
+
+		for (int index = 0; index < array.Count; ++index)
 		{
-			const bool found = ContainsIf(b, [&](const Region& other)
+			const uint8_t* const a = before + index * array.RecordSize;
+			const uint8_t* const b = after + index * array.RecordSize;
+
+			//collect changed bytes of the record, skipping equal words without looking at their bytes
+			std::vector<std::size_t> changed;
+			for (std::size_t offset = 0; offset < array.RecordSize; offset += 8)
 			{
-				return other.Base == region.Base;
-			});
+				const std::size_t width = std::min<std::size_t>(8, array.RecordSize - offset);
+				uint64_t x = 0, y = 0;
+				std::memcpy(&x, a + offset, width);
+				std::memcpy(&y, b + offset, width);
+				if (x == y)
+					continue;
+				for (std::size_t byte = offset; byte < offset + width; ++byte)
+				{
+					if (a[byte] != b[byte])
+						changed.push_back(byte);
+				}
+			}
 
-			if (!found)
+			for (std::size_t i = 0; i < changed.size(); )
 			{
-				std::cout << "Region at " << region.Base << " does not exist in " << doesNotExistIn << std::endl;
-				ShowRegion(region);
+				//one report per run of adjacent changed bytes within the same field
+				const FieldInfo& field = FindField(array, changed[i]);
+				std::size_t end = i + 1;
+				while (end < changed.size() && changed[end] == changed[end - 1] + 1 && changed[end] < field.Offset + field.Size)
+					++end;
+
+				std::cout << array.Side << ' ' << array.Name << '[' << index << "] +" << changed[i] << ' ' << field.Name;
+				if (field.Size > 1)
+					std::cout << '[' << (changed[i] - field.Offset) << ']';
+				std::cout << ':';
+				for (std::size_t j = i; j < end; ++j)
+					std::cout << ' ' << (int)a[changed[j]];
+				std::cout << " ->";
+				for (std::size_t j = i; j < end; ++j)
+					std::cout << ' ' << (int)b[changed[j]];
+				std::cout << std::endl;
+
+				numChanges += 1;
+				i = end;
 			}
 		}
+	}
+	std::cout << numChanges << " changed fields\n";
+}
+
+static void SelectMatchKernel(const std::string& name)
+{
+	for (int i = 0; i < NumMatchKernels; ++i)
+	{
+		const MatchKernel kernel = static_cast<MatchKernel>(i);
+		if (name.empty())
+		{
+			std::cout << (kernel == _matchKernel ? "* " : "  ") << GetMatchKernelName(kernel);
+			if (!IsMatchKernelSupported(kernel))
+				std::cout << " (not supported by this CPU)";
+			std::cout << std::endl;
+		}
+		else if (name == GetMatchKernelName(kernel))
+		{
+			if (!IsMatchKernelSupported(kernel))
+			{
+				std::cout << "Not supported by this CPU\n";
+				return;
+			}
+			_matchKernel = kernel;
+			std::cout << "Matching with " << name << std::endl;
+			return;
+		}
+	}
+	if (!name.empty())
+		std::cout << "Unknown kernel " << name << std::endl;
+}
+
+//the messages of a HiddenDragon log, each logged as a "Received ..." line followed by its bytes in decimal
+static std::vector<std::vector<uint8_t>> LoadLoggedMessages(const std::string& filename)
+{
+	std::vector<std::vector<uint8_t>> messages;
+	std::ifstream is(filename);
+	std::string line;
+	while (std::getline(is, line))
+	{
+		std::size_t size;
+		if (std::sscanf(line.c_str(), "Received %zu byte message", &size) != 1 || !std::getline(is, line))
+			continue;
+
+		std::istringstream bytes(line);
+		std::vector<uint8_t> message;
+		int value;
+		while (message.size() < size && bytes >> value)
+			message.push_back(static_cast<uint8_t>(value));
+		if (message.size() == size)
+			messages.push_back(std::move(message));
+	}
+	return messages;
+}
+
+namespace
+{
+	//where one logged message was found, see FindMessages
+	struct MessageLocations
+	{
+		std::vector<std::pair<int32_t, int32_t>> Exact; //index and region base, at most MaxMessageLocationsStored of them
+		std::size_t NumExact = 0;
+		TopMatches Partial{ MaxMessagePartialsStored };
 	};
-	
-	checkForAdditions(regionsOfSource, regionsOfTarget, "new");
-	checkForAdditions(regionsOfTarget, regionsOfSource, "old");
 }
 
-int main()
+//exact and best partial locations of every message in a single pass over the regions, using a k-mer index of all messages
+//a window is only scored if it shares KmerIndex::K equal bytes in a row with a message, and not just a few byte values or a repeating
+//4 byte pattern, so partial matches with no such run are missed,
+//and is kept as a partial match if at least half its bytes are equal
+static std::vector<MessageLocations> FindMessages(const std::vector<const Region*>& regions, const std::vector<std::vector<uint8_t>>& messages,
+	unsigned numThreads)
+{
+	KmerIndex index;
+	index.Build(messages);
+	std::size_t maxLength = 0;
+	for (const std::vector<uint8_t>& message : messages)
+		maxLength = std::max(maxLength, message.size());
+
+	WorkStealingPool pool(numThreads);
+	std::vector<std::vector<MessageLocations>> workers(pool.GetNumWorkers(), std::vector<MessageLocations>(messages.size()));
+	for (const Region* region : regions)
+	{
+		for (std::size_t begin = 0; begin < region->Data.size(); begin += MatchChunkSize)
+		{
+			//windows starting in [begin, end), whose k-mers reach up to a message length further
+			const std::size_t end = std::min(begin + MatchChunkSize, region->Data.size());
+			pool.Add([&, region, begin, end](unsigned worker)
+			{
+				const std::vector<uint8_t>& data = region->Data;
+				std::vector<MessageLocations>& locations = workers[worker];
+				std::unordered_set<uint64_t> scored;
+				const std::size_t last = std::min(data.size(), end + maxLength);
+				index.FindHits(data.data() + begin, last - begin, [&](std::size_t position, const KmerIndex::Occurrence& occurrence)
+				{
+					const std::vector<uint8_t>& message = messages[occurrence.Sequence];
+					if (position < occurrence.Offset)
+						return;
+					const std::size_t start = begin + position - occurrence.Offset;
+					if (start >= end || start + message.size() > data.size())
+						return;
+					if (!scored.insert(uint64_t(occurrence.Sequence) << 32 | start).second)
+						return; //hit by an earlier k-mer of the same window
+
+					int score = 0;
+					for (std::size_t j = 0; j < message.size(); ++j)
+						score += data[start + j] == message[j];
+
+					MessageLocations& location = locations[occurrence.Sequence];
+					if (score == (int)message.size())
+					{
+						if (location.Exact.size() < MaxMessageLocationsStored)
+							location.Exact.emplace_back(static_cast<int32_t>(start), region->Base);
+						++location.NumExact;
+					}
+					else if (score >= (int)message.size() / 2)
+					{
+						Match match;
+						match.Index = (int)start;
+						match.Score = score;
+						match.pRegion = region;
+						match.pWorkBuffer = &data;
+						location.Partial.Add(match);
+					}
+				});
+			});
+		}
+	}
+	pool.Run();
+
+	std::vector<MessageLocations> merged(messages.size());
+	for (const std::vector<MessageLocations>& worker : workers)
+	{
+		for (std::size_t m = 0; m < messages.size(); ++m)
+		{
+			merged[m].Exact.insert(merged[m].Exact.end(), worker[m].Exact.begin(), worker[m].Exact.end());
+			merged[m].NumExact += worker[m].NumExact;
+			merged[m].Partial.Merge(worker[m].Partial);
+		}
+	}
+	for (MessageLocations& location : merged)
+	{
+		std::sort(location.Exact.begin(), location.Exact.end(), [](const std::pair<int32_t, int32_t>& lhs, const std::pair<int32_t, int32_t>& rhs)
+		{
+			return std::make_pair(lhs.second, lhs.first) < std::make_pair(rhs.second, rhs.first);
+		});
+		if (location.Exact.size() > MaxMessageLocationsStored)
+			location.Exact.resize(MaxMessageLocationsStored);
+	}
+	return merged;
+}
+
+//the first 4 bytes of a message
+static uint32_t GetMessageType(const std::vector<uint8_t>& message)
+{
+	uint32_t type = 0;
+	if (message.size() >= sizeof(type))
+		std::memcpy(&type, message.data(), sizeof(type));
+	return type;
+}
+
+//messages without their first headerSize bytes, for when the header isn't kept in memory
+static std::vector<std::vector<uint8_t>> GetPayloads(const std::vector<std::vector<uint8_t>>& messages, std::size_t headerSize)
+{
+	std::vector<std::vector<uint8_t>> payloads;
+	for (const std::vector<uint8_t>& message : messages)
+		payloads.emplace_back(message.begin() + std::min(headerSize, message.size()), message.end());
+	return payloads;
+}
+
+//arguments: HiddenDragon log, then optionally how many header bytes of each message to leave out
+//every logged message against the (selected regions of the) top image in one pass
+static void FindLoggedMessages(const std::string& args)
+{
+	if (_imageStack.empty() || _imageStack.back().IsEmpty())
+		return;
+
+	std::istringstream ss(args);
+	std::string filename;
+	std::size_t headerSize = 0;
+	ss >> filename >> headerSize;
+	const std::vector<std::vector<uint8_t>> messages = LoadLoggedMessages(filename);
+	if (messages.empty())
+	{
+		std::cout << "No messages in " << filename << std::endl;
+		return;
+	}
+
+	const std::vector<std::vector<uint8_t>> payloads = GetPayloads(messages, headerSize);
+	const auto start = std::chrono::high_resolution_clock::now();
+	const std::vector<MessageLocations> locations = FindMessages(GetSelectedRegions(_imageStack.back(), _selectedRegionBase), payloads, GetNumThreads());
+	const std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+
+	std::size_t numFound = 0;
+	std::size_t numTooShort = 0;
+	for (std::size_t m = 0; m < messages.size(); ++m)
+	{
+		const MessageLocations& location = locations[m];
+		if (payloads[m].size() < KmerIndex::K)
+			++numTooShort;
+		if (location.NumExact == 0 && location.Partial.GetSize() == 0)
+			continue;
+		++numFound;
+
+		std::cout << "Message " << m << " of type " << GetMessageType(messages[m]) << ", " << payloads[m].size() << " bytes: "
+			<< location.NumExact << " exact";
+		for (const auto& exact : location.Exact)
+			std::cout << " " << exact.first << "[" << exact.second << "]";
+		std::cout << std::endl;
+		for (const Match& match : location.Partial.GetSorted())
+			std::cout << "  partial at " << match.Index << "[" << match.pRegion->Base << "] of score " << match.Score << "/" << payloads[m].size() << std::endl;
+	}
+	std::cout << "Found " << numFound << " of " << messages.size() << " messages in " << time.count() << " s";
+	if (numTooShort > 0)
+		std::cout << ", " << numTooShort << " shorter than " << KmerIndex::K << " bytes can't be found";
+	std::cout << std::endl;
+}
+
+//times every supported kernel matching each logged message against the top image, or against all messages
+//back to back if no image is loaded, and checks they all find the same windows
+static void BenchmarkMatchKernels(const std::string& filename)
+{
+	const std::vector<std::vector<uint8_t>> messages = LoadLoggedMessages(filename);
+	if (messages.empty())
+	{
+		std::cout << "No messages in " << filename << std::endl;
+		return;
+	}
+
+	std::vector<const std::vector<uint8_t>*> buffers;
+	std::vector<uint8_t> concatenated;
+	if (!_imageStack.empty() && !_imageStack.back().IsEmpty())
+	{
+		for (const Region& region : _imageStack.back().Regions)
+			buffers.push_back(&region.Data);
+	}
+	else
+	{
+		for (const std::vector<uint8_t>& message : messages)
+			concatenated.insert(concatenated.end(), message.begin(), message.end());
+		buffers.push_back(&concatenated);
+	}
+	std::size_t totalBytes = 0;
+	for (const std::vector<uint8_t>* buffer : buffers)
+		totalBytes += buffer->size();
+
+	//half the message must match, about where the threshold of a full TopMatches settles
+	uint64_t expectedHits = 0;
+	for (int i = 0; i < NumMatchKernels; ++i)
+	{
+		const MatchKernel kernel = static_cast<MatchKernel>(i);
+		if (!IsMatchKernelSupported(kernel))
+			continue;
+
+		uint64_t hits = 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (const std::vector<uint8_t>& message : messages)
+		{
+			const int minScore = static_cast<int>(message.size() / 2);
+			for (const std::vector<uint8_t>* buffer : buffers)
+			{
+				MatchHamming(kernel, buffer->data(), buffer->size(), message.data(), message.size(), minScore, [&](std::size_t, int)
+				{
+					++hits;
+					return minScore;
+				});
+			}
+		}
+		const std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+
+		std::cout << GetMatchKernelName(kernel) << ": " << time.count() << " s, "
+			<< (totalBytes * messages.size() / 1e6) / time.count() << " MB/s, " << hits << " windows";
+		if (kernel == MatchKernel::Scalar)
+			expectedHits = hits;
+		else if (hits != expectedHits)
+			std::cout << " MISMATCH";
+		std::cout << std::endl;
+	}
+	std::cout << messages.size() << " messages against " << totalBytes << " bytes\n";
+}
+
+//times partial matching of a sequence against every region of the top image with 1 thread up to one per core,
+//and checks every thread count keeps matches of the same scores
+static void BenchmarkParallelMatching(const std::string& description)
+{
+	if (_imageStack.empty() || _imageStack.back().IsEmpty())
+		return;
+
+	const std::vector<uint8_t> sequence = GetByteSequenceFromDescription(description);
+	if (sequence.empty())
+		return;
+
+	std::vector<const Region*> regions;
+	std::size_t totalBytes = 0;
+	for (const Region& region : _imageStack.back().Regions)
+	{
+		regions.push_back(&region);
+		totalBytes += region.Data.size();
+	}
+
+	std::vector<int> expectedScores;
+	double singleThreadTime = 0.0;
+	for (unsigned numThreads = 1; numThreads <= GetNumThreads(); ++numThreads)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		const SequenceMatching matching = MatchInParallel(sequence, regions, false, numThreads);
+		const std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+
+		std::vector<int> scores;
+		for (const Match& match : matching.GetMatches())
+			scores.push_back(match.Score);
+		if (numThreads == 1)
+		{
+			expectedScores = scores;
+			singleThreadTime = time.count();
+		}
+
+		std::cout << numThreads << " threads: " << time.count() << " s, " << (totalBytes / 1e6) / time.count() << " MB/s, speedup "
+			<< singleThreadTime / time.count();
+		if (scores != expectedScores)
+			std::cout << " MISMATCH";
+		std::cout << std::endl;
+	}
+	std::cout << totalBytes << " bytes in " << regions.size() << " regions, kernel " << GetMatchKernelName(_matchKernel) << std::endl;
+}
+
+//arguments: shared offset of the dump, address as shown by BinExplorer, then optionally max offset and depth
+//dumps store region bases relative to the shared offset but pointer values as they were in CC3.exe
+static void FindPointers(const std::string& args)
+{
+	if (_imageStack.empty())
+		return;
+
+	std::istringstream is(args);
+	std::string sharedOffsetString, addressString;
+	uint32_t maxOffset = 4096;
+	int maxDepth = 3;
+	if (!(is >> sharedOffsetString >> addressString))
+	{
+		std::cout << "Usage: ptrs <shared offset> <address> [max offset] [depth]\n";
+		return;
+	}
+	is >> maxOffset >> maxDepth;
+	const uint32_t sharedOffset = static_cast<uint32_t>(std::strtoll(sharedOffsetString.c_str(), nullptr, 0));
+	const int32_t address = static_cast<int32_t>(std::strtoll(addressString.c_str(), nullptr, 0));
+
+	const Image& image = _imageStack.back();
+	std::vector<PointerScanRegion> regions;
+	for (const Region& region : image.Regions)
+		regions.push_back({ region.Base + sharedOffset, region.Data.data(), region.Data.size() });
+	const Region* anchorRegion = image.FindRegionAt(0); //bases are relative to the anchor
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	PointerIndex index;
+	index.Build(regions);
+	const std::chrono::duration<double> buildTime = std::chrono::high_resolution_clock::now() - start;
+	std::cout << "Indexed " << index.GetSize() << " pointers in " << buildTime.count() << " s\n";
+
+	const std::vector<PointerChain> chains = index.FindChains(address + sharedOffset, maxOffset, maxDepth, 100);
+	for (const PointerChain& chain : chains)
+	{
+		//as PointerPath offsets from the Title anchor, * marks roots in the anchor's own region
+		const int32_t root = static_cast<int32_t>(chain.Root - sharedOffset);
+		const bool nextToAnchor = anchorRegion && image.FindRegionAt(root) == anchorRegion;
+		std::cout << (nextToAnchor ? "* " : "  ") << root;
+		for (int32_t offset : chain.Offsets)
+			std::cout << " -> +" << offset;
+		std::cout << std::endl;
+	}
+	std::cout << chains.size() << " pointer paths found\n";
+}
+
+//command is everything up to the first space, arg the rest
+static void SplitCommand(const std::string& line, std::string& command, std::string& arg)
+{
+	const auto delimiterPos = line.find(' ');
+	command = line.substr(0, delimiterPos == std::string::npos ? line.size() : delimiterPos);
+	arg.clear();
+	if (delimiterPos != std::string::npos)
+	{
+		arg = line.substr(delimiterPos + 1, line.size() - 1 - delimiterPos);
+	}
+}
+
+static std::string ToJsonString(const std::string& text)
+{
+	std::string json = "\"";
+	for (const char c : text)
+	{
+		switch (c)
+		{
+		case '"':
+			json += "\\\"";
+			break;
+		case '\\':
+			json += "\\\\";
+			break;
+		case '\n':
+			json += "\\n";
+			break;
+		case '\t':
+			json += "\\t";
+			break;
+		default:
+			//dumps and commands aren't necessarily UTF-8, so bytes above ASCII are escaped as the code point of the same value
+			if (static_cast<unsigned char>(c) < 32 || static_cast<unsigned char>(c) >= 0x80)
+			{
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+				json += escaped;
+			}
+			else
+				json += c;
+		}
+	}
+	return json + "\"";
+}
+
+//opens a JSON Lines object, the caller adds its own fields and closes it
+static std::ostream& BeginJsonLine(std::ostream& os, const std::string& dump, const std::string& command, const char* type)
 {
+	return os << "{\"dump\":" << ToJsonString(dump) << ",\"command\":" << ToJsonString(command) << ",\"type\":\"" << type << "\"";
+}
+
+//runs commands against one dump the way the prompt would, but without ever asking anything, and returns the JSON Lines
+//only commands that make sense without an image stack are supported: selr, index, finds, finde and findm
+static std::string RunBatchCommands(const std::string& dump, bool segmented, const std::vector<std::string>& commands, unsigned numThreads)
+{
+	std::ostringstream out;
+	Image image;
+	if (!ReadImage(dump, segmented, image))
+	{
+		BeginJsonLine(out, dump, "", "error") << ",\"message\":\"No such file\"}\n";
+		return out.str();
+	}
+
+	uint32_t selectedRegionBase = NoRegionSelected;
+	for (const std::string& line : commands)
+	{
+		std::string command;
+		std::string arg;
+		SplitCommand(line, command, arg);
+
+		if (command == "selr")
+		{
+			const bool isBase = !arg.empty() && std::all_of(arg.cbegin(), arg.cend(), [](char c)
+			{
+				return std::isdigit(c);
+			});
+			const uint32_t addr = isBase ? static_cast<uint32_t>(std::atoll(arg.c_str())) : NoRegionSelected;
+			if (arg.empty() || (isBase && image.FindRegion(static_cast<int32_t>(addr))))
+			{
+				selectedRegionBase = addr;
+			}
+			else
+			{
+				BeginJsonLine(out, dump, line, "error") << ",\"message\":\"No region with such a base address\"}\n";
+			}
+		}
+		else if (command == "index")
+		{
+			if (!LoadIndex(image))
+			{
+				BuildSuffixArrays(image, numThreads);
+				SaveIndex(image);
+			}
+		}
+		else if (command == "findm")
+		{
+			std::istringstream ss(arg);
+			std::string filename;
+			std::size_t headerSize = 0;
+			ss >> filename >> headerSize;
+			const std::vector<std::vector<uint8_t>> messages = LoadLoggedMessages(filename);
+			if (messages.empty())
+			{
+				BeginJsonLine(out, dump, line, "error") << ",\"message\":\"No messages in log\"}\n";
+				continue;
+			}
+
+			//one line per message found, with its exact and partial locations
+			const std::vector<std::vector<uint8_t>> payloads = GetPayloads(messages, headerSize);
+			const std::vector<MessageLocations> locations = FindMessages(GetSelectedRegions(image, selectedRegionBase), payloads, numThreads);
+			std::size_t numFound = 0;
+			for (std::size_t m = 0; m < messages.size(); ++m)
+			{
+				const MessageLocations& location = locations[m];
+				if (location.NumExact == 0 && location.Partial.GetSize() == 0)
+					continue;
+				++numFound;
+
+				BeginJsonLine(out, dump, line, "message") << ",\"message\":" << m << ",\"messageType\":" << GetMessageType(messages[m])
+					<< ",\"length\":" << payloads[m].size() << ",\"numExact\":" << location.NumExact << ",\"exact\":[";
+				for (std::size_t i = 0; i < location.Exact.size(); ++i)
+				{
+					out << (i > 0 ? "," : "") << "{\"region\":" << location.Exact[i].second << ",\"index\":" << location.Exact[i].first << "}";
+				}
+				out << "],\"partial\":[";
+				const std::vector<Match> partial = location.Partial.GetSorted();
+				for (std::size_t i = 0; i < partial.size(); ++i)
+				{
+					out << (i > 0 ? "," : "") << "{\"region\":" << partial[i].pRegion->Base << ",\"index\":" << partial[i].Index
+						<< ",\"score\":" << partial[i].Score << "}";
+				}
+				out << "]}\n";
+			}
+			BeginJsonLine(out, dump, line, "summary") << ",\"messages\":" << messages.size() << ",\"found\":" << numFound << "}\n";
+		}
+		else if (command == "finds" || command == "finde")
+		{
+			const std::vector<PatternByte> pattern = GetBytePatternFromDescription(arg);
+			if (pattern.empty())
+			{
+				BeginJsonLine(out, dump, line, "error") << ",\"message\":\"Empty sequence\"}\n";
+				continue;
+			}
+			if (!IsLiteral(pattern))
+			{
+				std::vector<std::pair<int32_t, int32_t>> matches;
+				const std::size_t numMatches = FindPatternMatches(GetSelectedRegions(image, selectedRegionBase), pattern, MaxExactMatchesShown, numThreads, matches);
+				for (const auto& match : matches)
+				{
+					BeginJsonLine(out, dump, line, "exact") << ",\"region\":" << match.second << ",\"index\":" << match.first << "}\n";
+				}
+				BeginJsonLine(out, dump, line, "summary") << ",\"exact\":" << numMatches << ",\"partial\":0}\n";
+				continue;
+			}
+
+			const std::vector<uint8_t> sequence = GetByteSequenceFromDescription(arg);
+
+			std::size_t numExact = 0;
+			if (IsIndexed(image))
+			{
+				const auto matches = FindExactMatches(image, selectedRegionBase, sequence);
+				for (std::size_t i = 0; i < matches.size() && i < MaxExactMatchesShown; ++i)
+				{
+					BeginJsonLine(out, dump, line, "exact") << ",\"region\":" << matches[i].second << ",\"index\":" << matches[i].first << "}\n";
+				}
+				numExact = matches.size();
+			}
+
+			std::size_t numPartial = 0;
+			if (numExact == 0)
+			{
+				const SequenceMatching matching = MatchInParallel(sequence, GetSelectedRegions(image, selectedRegionBase), command == "finde", numThreads);
+				for (const Match& match : matching.GetMatches())
+				{
+					BeginJsonLine(out, dump, line, "partial") << ",\"region\":" << match.pRegion->Base << ",\"index\":" << match.Index
+						<< ",\"score\":" << match.Score << ",\"length\":" << sequence.size() << "}\n";
+					++numPartial;
+				}
+			}
+			BeginJsonLine(out, dump, line, "summary") << ",\"exact\":" << numExact << ",\"partial\":" << numPartial << "}\n";
+		}
+		else
+		{
+			BeginJsonLine(out, dump, line, "error") << ",\"message\":\"Unsupported in batch mode\"}\n";
+		}
+	}
+	return out.str();
+}
+
+//BinExplorer [-segmented] [-j dumps] (-s script | -c command)... dump...
+//runs the commands, one per script line, against every dump and prints JSON Lines to stdout instead of prompting
+//a loaded dump can take well over a GB with its index, so by default one dump is in memory at a time and the commands
+//split its regions across all cores, -j allows more dumps in flight each with a share of the cores
+//each dump's lines come out together once it is done
+static int RunBatch(int argc, char* argv[])
+{
+	bool segmented = false;
+	unsigned numJobs = 1;
+	std::vector<std::string> commands;
+	std::vector<std::string> dumps;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "-segmented")
+		{
+			segmented = true;
+		}
+		else if (arg == "-j" && i + 1 < argc)
+		{
+			numJobs = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+		}
+		else if (arg == "-c" && i + 1 < argc)
+		{
+			commands.push_back(argv[++i]);
+		}
+		else if (arg == "-s" && i + 1 < argc)
+		{
+			std::ifstream script(argv[++i]);
+			if (!script)
+			{
+				std::cerr << "No such script " << argv[i] << std::endl;
+				return 1;
+			}
+			for (std::string line; std::getline(script, line); )
+			{
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				if (!line.empty() && line[0] != '#')
+					commands.push_back(line);
+			}
+		}
+		else
+		{
+			dumps.push_back(arg);
+		}
+	}
+	if (commands.empty() || dumps.empty())
+	{
+		std::cerr << "Usage: BinExplorer [-segmented] [-j dumps] (-s script | -c command)... dump...\n";
+		return 1;
+	}
+
+	//largest dumps first so a huge one doesn't start last
+	std::vector<std::pair<uintmax_t, std::string>> order;
+	for (const std::string& dump : dumps)
+	{
+		std::error_code error;
+		const uintmax_t size = std::experimental::filesystem::file_size(dump, error);
+		order.emplace_back(error ? 0 : size, dump);
+	}
+	std::stable_sort(order.begin(), order.end(), [](const std::pair<uintmax_t, std::string>& lhs, const std::pair<uintmax_t, std::string>& rhs)
+	{
+		return lhs.first > rhs.first;
+	});
+
+	numJobs = std::min<unsigned>(numJobs, static_cast<unsigned>(order.size()));
+	const unsigned threadsPerJob = std::max(1u, GetNumThreads() / numJobs);
+	WorkStealingPool pool(numJobs);
+	std::mutex outputMutex;
+	for (const auto& dump : order)
+	{
+		pool.Add([&](unsigned)
+		{
+			const std::string lines = RunBatchCommands(dump.second, segmented, commands, threadsPerJob);
+			std::lock_guard<std::mutex> lock(outputMutex);
+			std::cout << lines << std::flush;
+		});
+	}
+	pool.Run();
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1)
+		return RunBatch(argc, argv);
+
 	std::cout << "BinExplorer commands:\n";
 	std::cout << "loadb" << std::endl;
 	std::cout << "loads" << std::endl;
 	std::cout << "selr" << std::endl;
+	std::cout << "index" << std::endl;
 	std::cout << "finds" << std::endl;
+	std::cout << "finde" << std::endl;
+	std::cout << "findm" << std::endl;
 	std::cout << "diffb" << std::endl;
 	std::cout << "diffs" << std::endl;
 	std::cout << "diffr" << std::endl;
+	std::cout << "difft" << std::endl;
+	std::cout << "ptrs" << std::endl;
+	std::cout << "kern" << std::endl;
+	std::cout << "bench" << std::endl;
+	std::cout << "benchp" << std::endl;
 	std::cout << "push" << std::endl;
 	std::cout << "pop" << std::endl;
 	std::cout << "cls" << std::endl;
@@ -669,14 +2050,9 @@ int main()
 		needsPrompt = true;
 
 		std::cin.getline(lineBuffer, sizeof(lineBuffer) - 1);
-		const std::string line = lineBuffer;
-		const auto delimiterPos = line.find(' ');
-		const std::string command = line.substr(0, delimiterPos == std::string::npos ? line.size() : delimiterPos);
+		std::string command;
 		std::string arg;
-		if (delimiterPos != std::string::npos)
-		{
-			arg = line.substr(delimiterPos + 1, line.size() - 1 - delimiterPos);
-		}
+		SplitCommand(lineBuffer, command, arg);
 
 		if (command == "")
 		{
@@ -696,9 +2072,21 @@ int main()
 		{
 			SelectRegion(arg);
 		}
+		else if (command == "index")
+		{
+			BuildIndex();
+		}
 		else if (command == "finds")
 		{
-			FindSequence(arg);
+			FindSequence(arg, false);
+		}
+		else if (command == "finde")
+		{
+			FindSequence(arg, true);
+		}
+		else if (command == "findm")
+		{
+			FindLoggedMessages(arg);
 		}
 		else if (command == "findd")
 		{
@@ -716,6 +2104,26 @@ int main()
 		{
 			FindRegionDiffs();
 		}
+		else if (command == "difft")
+		{
+			ShowTypedDiffs(arg);
+		}
+		else if (command == "ptrs")
+		{
+			FindPointers(arg);
+		}
+		else if (command == "kern")
+		{
+			SelectMatchKernel(arg);
+		}
+		else if (command == "bench")
+		{
+			BenchmarkMatchKernels(arg);
+		}
+		else if (command == "benchp")
+		{
+			BenchmarkParallelMatching(arg);
+		}
 		else if (command == "push")
 		{
 			PushImageIfNeeded();
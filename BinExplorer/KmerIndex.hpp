@@ -0,0 +1,103 @@
+#pragma once
+
+//every K byte substring (k-mer) of a set of sequences, to find where any of them occur in a buffer in a single pass
+//each buffer position costs one 8-byte load and a bit test, only the few passing the filter are looked up
+
+class KmerIndex
+{
+public:
+	static constexpr std::size_t K = 8;
+
+	struct Occurrence
+	{
+		uint64_t Kmer;
+		uint32_t Sequence;
+		uint32_t Offset;
+
+		bool operator<(const Occurrence& rhs) const
+		{
+			return Kmer < rhs.Kmer;
+		}
+	};
+
+	//low complexity k-mers are left out, zeroed or filled memory and arrays of small values and pointers would hit them everywhere
+	void Build(const std::vector<std::vector<uint8_t>>& sequences)
+	{
+		_Occurrences.clear();
+		_Filter.assign((std::size_t(1) << FilterBits) / 64, 0);
+		for (std::size_t s = 0; s < sequences.size(); ++s)
+		{
+			const std::vector<uint8_t>& sequence = sequences[s];
+			for (std::size_t offset = 0; offset + K <= sequence.size(); ++offset)
+			{
+				const uint64_t kmer = Load(sequence.data() + offset);
+				if (IsLowComplexity(kmer))
+					continue;
+
+				_Occurrences.push_back({ kmer, static_cast<uint32_t>(s), static_cast<uint32_t>(offset) });
+				const std::size_t bit = Hash(kmer);
+				_Filter[bit / 64] |= uint64_t(1) << (bit % 64);
+			}
+		}
+		std::sort(_Occurrences.begin(), _Occurrences.end());
+	}
+
+	std::size_t GetSize() const
+	{
+		return _Occurrences.size();
+	}
+
+	//calls func(position, occurrence) for every k-mer starting at a position of data that occurs in a sequence
+	template <typename FuncT>
+	void FindHits(const uint8_t* data, std::size_t size, FuncT func) const
+	{
+		for (std::size_t position = 0; position + K <= size; ++position)
+		{
+			const uint64_t kmer = Load(data + position);
+			const std::size_t bit = Hash(kmer);
+			if (!(_Filter[bit / 64] & (uint64_t(1) << (bit % 64))))
+				continue;
+
+			const Occurrence key = { kmer, 0, 0 };
+			for (auto it = std::lower_bound(_Occurrences.cbegin(), _Occurrences.cend(), key); it != _Occurrences.cend() && it->Kmer == kmer; ++it)
+				func(position, *it);
+		}
+	}
+private:
+	static constexpr int FilterBits = 22; //512 KB, a few percent false positives for thousands of messages
+
+	std::vector<Occurrence> _Occurrences; //sorted by k-mer
+	std::vector<uint64_t> _Filter; //bit set for the hash of every indexed k-mer
+
+	static uint64_t Load(const uint8_t* data)
+	{
+		uint64_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	static std::size_t Hash(uint64_t kmer)
+	{
+		return static_cast<std::size_t>((kmer * 0x9E3779B97F4A7C15ull) >> (64 - FilterBits));
+	}
+
+	//at most two distinct bytes, e.g. a run or a small integer among zeros, or repeating every 4 bytes
+	static bool IsLowComplexity(uint64_t kmer)
+	{
+		if ((kmer ^ (kmer >> 32)) << 32 == 0)
+			return true;
+
+		const uint8_t first = static_cast<uint8_t>(kmer);
+		int second = -1;
+		for (std::size_t i = 1; i < K; ++i)
+		{
+			const uint8_t byte = static_cast<uint8_t>(kmer >> (8 * i));
+			if (byte == first || byte == second)
+				continue;
+			if (second >= 0)
+				return false;
+			second = byte;
+		}
+		return true;
+	}
+};
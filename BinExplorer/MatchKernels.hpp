@@ -0,0 +1,359 @@
+#pragma once
+
+//approximate matching of a byte sequence against every position of a buffer
+//all kernels report through report(index, score), which returns the lowest score still of interest
+
+#ifdef _MSC_VER
+#define MATCH_KERNEL_AVX2 //MSVC emits AVX2 intrinsics without /arch, they are only called once cpuid says so
+#else
+#define MATCH_KERNEL_AVX2 __attribute__((target("avx2,popcnt")))
+#endif
+
+enum class MatchKernel
+{
+	Scalar, //byte by byte, the reference
+	Sse2, //16 sequence bytes per compare
+	Avx2, //32 sequence bytes per compare
+	BitSliced, //64 windows per compare
+};
+constexpr int NumMatchKernels = 4;
+
+namespace MatchKernelsDetail
+{
+	inline int Popcount(uint32_t x)
+	{
+		x = x - ((x >> 1) & 0x55555555);
+		x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+		return (int)((((x + (x >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24);
+	}
+
+	inline bool CpuSupportsAvx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+		const bool popcnt = (info[2] & (1 << 23)) != 0;
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && popcnt && (info[1] & (1 << 5));
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+	}
+
+	//bit k set where data[k] == value, for the 64 bytes at data (fewer if available is smaller)
+	inline uint64_t EqualMask(const uint8_t* data, std::size_t available, __m128i value)
+	{
+		if (available >= 64)
+		{
+			const uint64_t m0 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)data), value));
+			const uint64_t m1 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), value));
+			const uint64_t m2 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), value));
+			const uint64_t m3 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), value));
+			return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+		}
+
+		const uint8_t byte = (uint8_t)_mm_cvtsi128_si32(value);
+		uint64_t mask = 0;
+		for (std::size_t k = 0; k < available; ++k)
+			mask |= (uint64_t)(data[k] == byte) << k;
+		return mask;
+	}
+
+	//number of equal bytes of the window at data
+	inline int ScoreScalar(const uint8_t* data, const uint8_t* sequence, std::size_t length)
+	{
+		int score = 0;
+		for (std::size_t j = 0; j < length; ++j)
+			score += data[j] == sequence[j];
+		return score;
+	}
+}
+
+inline const char* GetMatchKernelName(MatchKernel kernel)
+{
+	static const char* const names[NumMatchKernels] = { "scalar", "sse2", "avx2", "bitsliced" };
+	return names[(int)kernel];
+}
+
+inline bool IsMatchKernelSupported(MatchKernel kernel)
+{
+	static const bool avx2 = MatchKernelsDetail::CpuSupportsAvx2();
+	return kernel != MatchKernel::Avx2 || avx2;
+}
+
+//fastest kernel the CPU runs for sequences of a typical message length
+inline MatchKernel GetDefaultMatchKernel()
+{
+	return IsMatchKernelSupported(MatchKernel::Avx2) ? MatchKernel::Avx2 : MatchKernel::Sse2;
+}
+
+//plain loop over every window, what the other kernels are measured against
+template <typename ReportFuncT>
+void MatchHammingScalar(const uint8_t* data, std::size_t size, const uint8_t* sequence, std::size_t length, int minScore, ReportFuncT report)
+{
+	if (length == 0 || length > size)
+		return;
+
+	for (std::size_t i = 0, n = size - length + 1; i < n; ++i)
+	{
+		const int score = MatchKernelsDetail::ScoreScalar(data + i, sequence, length);
+		if (score >= std::max(minScore, 1))
+			minScore = report(i, score);
+	}
+}
+
+//one window at a time, 16 sequence bytes per compare, windows stop early once they cannot reach minScore
+//the last compare of a window is masked, windows too close to the end for it to be loaded are done byte by byte
+template <typename ReportFuncT>
+void MatchHammingSse2(const uint8_t* data, std::size_t size, const uint8_t* sequence, std::size_t length, int minScore, ReportFuncT report)
+{
+	if (length == 0 || length > size)
+		return;
+
+	const std::size_t numChunks = (length + 15) / 16;
+	std::vector<uint8_t> padded(numChunks * 16, 0);
+	std::copy(sequence, sequence + length, padded.begin());
+	const uint32_t tailMask = length % 16 ? (1u << (length % 16)) - 1 : 0xffff;
+
+	const std::size_t numWindows = size - length + 1;
+	const std::size_t numVectorWindows = size >= numChunks * 16 ? std::min(numWindows, size - numChunks * 16 + 1) : 0;
+	for (std::size_t i = 0; i < numVectorWindows; ++i)
+	{
+		const int threshold = std::max(minScore, 1);
+		int score = 0;
+		std::size_t chunk = 0;
+		for (; chunk < numChunks; ++chunk)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*)(data + i + chunk * 16));
+			const __m128i b = _mm_loadu_si128((const __m128i*)(padded.data() + chunk * 16));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+			if (chunk + 1 == numChunks)
+				mask &= tailMask;
+			score += MatchKernelsDetail::Popcount(mask);
+			if (score + (int)(length - std::min(length, (chunk + 1) * 16)) < threshold)
+				break;
+		}
+		if (chunk == numChunks && score >= threshold)
+			minScore = report(i, score);
+	}
+	for (std::size_t i = numVectorWindows; i < numWindows; ++i)
+	{
+		const int score = MatchKernelsDetail::ScoreScalar(data + i, sequence, length);
+		if (score >= std::max(minScore, 1))
+			minScore = report(i, score);
+	}
+}
+
+//as the SSE2 kernel with 32 sequence bytes per compare, only call if IsMatchKernelSupported(MatchKernel::Avx2)
+template <typename ReportFuncT>
+MATCH_KERNEL_AVX2 void MatchHammingAvx2(const uint8_t* data, std::size_t size, const uint8_t* sequence, std::size_t length, int minScore, ReportFuncT report)
+{
+	if (length == 0 || length > size)
+		return;
+
+	const std::size_t numChunks = (length + 31) / 32;
+	std::vector<uint8_t> padded(numChunks * 32, 0);
+	std::copy(sequence, sequence + length, padded.begin());
+	const uint32_t tailMask = length % 32 ? (1u << (length % 32)) - 1 : 0xffffffff;
+
+	const std::size_t numWindows = size - length + 1;
+	const std::size_t numVectorWindows = size >= numChunks * 32 ? std::min(numWindows, size - numChunks * 32 + 1) : 0;
+	for (std::size_t i = 0; i < numVectorWindows; ++i)
+	{
+		const int threshold = std::max(minScore, 1);
+		int score = 0;
+		std::size_t chunk = 0;
+		for (; chunk < numChunks; ++chunk)
+		{
+			const __m256i a = _mm256_loadu_si256((const __m256i*)(data + i + chunk * 32));
+			const __m256i b = _mm256_loadu_si256((const __m256i*)(padded.data() + chunk * 32));
+			uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+			if (chunk + 1 == numChunks)
+				mask &= tailMask;
+			score += (int)_mm_popcnt_u32(mask);
+			if (score + (int)(length - std::min(length, (chunk + 1) * 32)) < threshold)
+				break;
+		}
+		if (chunk == numChunks && score >= threshold)
+			minScore = report(i, score);
+	}
+	for (std::size_t i = numVectorWindows; i < numWindows; ++i)
+	{
+		const int score = MatchKernelsDetail::ScoreScalar(data + i, sequence, length);
+		if (score >= std::max(minScore, 1))
+			minScore = report(i, score);
+	}
+}
+
+//Hamming score (number of equal bytes) of sequence against every window of data
+//each pattern byte is compared against 64 windows at once and the 64 scores are kept in bit-sliced counters,
+//plane p holding bit p of every window's score, so adding a comparison mask is a short ripple carry
+template <typename ReportFuncT>
+void MatchHammingBitSliced(const uint8_t* data, std::size_t size, const uint8_t* sequence, std::size_t length, int minScore, ReportFuncT report)
+{
+	if (length == 0 || length > size)
+		return;
+
+	int numPlanes = 1;
+	while ((std::size_t(1) << numPlanes) <= length)
+		++numPlanes;
+
+	//16 copies of every sequence byte, kept as bytes since containers of __m128i lose its alignment
+	std::vector<uint8_t> splats(length * 16);
+	for (std::size_t j = 0; j < length; ++j)
+		std::fill(splats.begin() + j * 16, splats.begin() + (j + 1) * 16, sequence[j]);
+
+	const std::size_t numWindows = size - length + 1;
+	uint64_t planes[64];
+	for (std::size_t block = 0; block < numWindows; block += 64)
+	{
+		std::fill(planes, planes + numPlanes, 0);
+		for (std::size_t j = 0; j < length; ++j)
+		{
+			uint64_t carry = MatchKernelsDetail::EqualMask(data + block + j, size - block - j, _mm_loadu_si128((const __m128i*)&splats[j * 16]));
+			for (int p = 0; p < numPlanes && carry; ++p)
+			{
+				const uint64_t overflow = planes[p] & carry;
+				planes[p] ^= carry;
+				carry = overflow;
+			}
+		}
+
+		//lanes scoring at least minScore, compared bit-sliced from the top plane down
+		const int threshold = std::max(minScore, 1);
+		uint64_t greater = 0;
+		uint64_t equal = ~uint64_t(0);
+		for (int p = numPlanes - 1; p >= 0; --p)
+		{
+			if ((threshold >> p) & 1)
+				equal &= planes[p];
+			else
+			{
+				greater |= equal & planes[p];
+				equal &= ~planes[p];
+			}
+		}
+		uint64_t hits = greater | equal;
+		if ((uint64_t)threshold >> numPlanes)
+			hits = 0; //more than any score can reach
+		if (numWindows - block < 64)
+			hits &= (uint64_t(1) << (numWindows - block)) - 1;
+
+		for (; hits; hits &= hits - 1)
+		{
+			unsigned long lane;
+#ifdef _MSC_VER
+			if (!_BitScanForward(&lane, (unsigned long)hits))
+			{
+				_BitScanForward(&lane, (unsigned long)(hits >> 32));
+				lane += 32;
+			}
+#else
+			lane = __builtin_ctzll(hits);
+#endif
+			int score = 0;
+			for (int p = 0; p < numPlanes; ++p)
+				score |= (int)((planes[p] >> lane) & 1) << p;
+			if (score >= minScore)
+				minScore = report(block + lane, score);
+		}
+	}
+}
+
+//Hamming score with the given kernel, which must be supported
+template <typename ReportFuncT>
+void MatchHamming(MatchKernel kernel, const uint8_t* data, std::size_t size, const uint8_t* sequence, std::size_t length, int minScore, ReportFuncT report)
+{
+	switch (kernel)
+	{
+	case MatchKernel::Scalar:
+		MatchHammingScalar(data, size, sequence, length, minScore, report);
+		break;
+	case MatchKernel::Sse2:
+		MatchHammingSse2(data, size, sequence, length, minScore, report);
+		break;
+	case MatchKernel::Avx2:
+		MatchHammingAvx2(data, size, sequence, length, minScore, report);
+		break;
+	case MatchKernel::BitSliced:
+		MatchHammingBitSliced(data, size, sequence, length, minScore, report);
+		break;
+	}
+}
+
+//length minus the edit distance of the best alignment of sequence ending at every position of data, so inserted
+//or removed bytes cost one point each instead of misaligning the rest of the window
+//Myers' bit-vector algorithm (1999) over blocks of 64 sequence bytes, the index reported is where an alignment
+//without gaps would start
+//alignments ending next to a good one score nearly as well, so only the best within length bytes either side is reported
+template <typename ReportFuncT>
+void MatchEditDistance(const uint8_t* data, std::size_t size, const uint8_t* sequence, std::size_t length, int minScore, ReportFuncT report)
+{
+	if (length == 0)
+		return;
+
+	const std::size_t numBlocks = (length + 63) / 64;
+	const uint64_t lastBit = uint64_t(1) << ((length - 1) % 64);
+	std::vector<uint64_t> peq(256 * numBlocks, 0);
+	for (std::size_t j = 0; j < length; ++j)
+		peq[sequence[j] * numBlocks + j / 64] |= uint64_t(1) << (j % 64);
+
+	std::vector<uint64_t> pv(numBlocks, ~uint64_t(0));
+	std::vector<uint64_t> mv(numBlocks, 0);
+	int distance = (int)length;
+	bool pending = false; //best alignment so far not yet beaten or left length bytes behind
+	std::size_t pendingEnd = 0;
+	int pendingScore = 0;
+	auto reportPending = [&]()
+	{
+		if (pending)
+			minScore = report(pendingEnd + 1 >= length ? pendingEnd + 1 - length : 0, pendingScore);
+		pending = false;
+	};
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		const uint64_t* const eqs = &peq[data[i] * numBlocks];
+		int hin = 0; //the alignment may start anywhere, so the top row is all zeros
+		for (std::size_t b = 0; b < numBlocks; ++b)
+		{
+			uint64_t eq = eqs[b];
+			const uint64_t p = pv[b];
+			const uint64_t m = mv[b];
+			const uint64_t xv = eq | m;
+			if (hin < 0)
+				eq |= 1;
+			const uint64_t xh = (((eq & p) + p) ^ p) | eq;
+			uint64_t ph = m | ~(xh | p);
+			uint64_t mh = p & xh;
+
+			const uint64_t high = b + 1 == numBlocks ? lastBit : uint64_t(1) << 63;
+			const int hout = (ph & high) ? 1 : (mh & high) ? -1 : 0;
+
+			ph <<= 1;
+			mh <<= 1;
+			if (hin < 0)
+				mh |= 1;
+			else if (hin > 0)
+				ph |= 1;
+			pv[b] = mh | ~(xv | ph);
+			mv[b] = ph & xv;
+			hin = hout;
+		}
+		distance += hin;
+
+		if (pending && i - pendingEnd > length)
+			reportPending();
+		const int score = (int)length - distance;
+		if (score >= std::max(minScore, 1) && (!pending || score > pendingScore))
+		{
+			pending = true;
+			pendingEnd = i;
+			pendingScore = score;
+		}
+	}
+	reportPending();
+}
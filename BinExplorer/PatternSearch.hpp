@@ -0,0 +1,146 @@
+#pragma once
+
+//exact search for byte patterns with wildcards, bit masks and ranges, e.g. a network record with a few random fields
+//the two most selective elements are tested against 16 windows per compare and only windows passing both are verified,
+//16 elements per compare as well, so no byte of the buffer costs a branch of its own
+
+//one element of a pattern, a byte matches if Lo <= (byte & Mask) <= Hi
+//a literal is { 0xFF, v, v }, a wildcard { 0, 0, 0 }
+struct PatternByte
+{
+	uint8_t Mask;
+	uint8_t Lo;
+	uint8_t Hi;
+
+	bool IsLiteral() const
+	{
+		return Mask == 0xFF && Lo == Hi;
+	}
+
+	bool Matches(uint8_t value) const
+	{
+		return static_cast<uint8_t>((value & Mask) - Lo) <= static_cast<uint8_t>(Hi - Lo);
+	}
+};
+
+namespace PatternSearchDetail
+{
+	//how many of the 256 byte values an element accepts
+	inline int CountAccepted(const PatternByte& element)
+	{
+		int count = 0;
+		for (int value = 0; value < 256; ++value)
+			count += element.Matches(static_cast<uint8_t>(value));
+		return count;
+	}
+
+	//all ones in the lanes of bytes matching, the range test is a wrapping subtract and an unsigned min
+	inline __m128i MatchLanes(__m128i bytes, __m128i mask, __m128i lo, __m128i span)
+	{
+		const __m128i shifted = _mm_sub_epi8(_mm_and_si128(bytes, mask), lo);
+		return _mm_cmpeq_epi8(_mm_min_epu8(shifted, span), shifted);
+	}
+
+	inline unsigned long LowestBit(uint32_t bits)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, bits);
+		return index;
+#else
+		return __builtin_ctz(bits);
+#endif
+	}
+}
+
+//calls report(index) for every window of data matching pattern, in order, until report returns false
+template <typename ReportFuncT>
+void FindPattern(const uint8_t* data, std::size_t size, const PatternByte* pattern, std::size_t length, ReportFuncT report)
+{
+	using namespace PatternSearchDetail;
+
+	if (length == 0 || length > size)
+		return;
+
+	//element arrays padded to whole vectors with wildcards
+	const std::size_t padded = (length + 15) / 16 * 16;
+	std::vector<uint8_t> masks(padded, 0);
+	std::vector<uint8_t> los(padded, 0);
+	std::vector<uint8_t> spans(padded, 0);
+	std::size_t first = 0;
+	std::size_t second = 0;
+	int firstAccepted = 257;
+	int secondAccepted = 257;
+	for (std::size_t j = 0; j < length; ++j)
+	{
+		masks[j] = pattern[j].Mask;
+		los[j] = pattern[j].Lo;
+		spans[j] = static_cast<uint8_t>(pattern[j].Hi - pattern[j].Lo);
+
+		const int accepted = CountAccepted(pattern[j]);
+		if (accepted < firstAccepted)
+		{
+			second = first;
+			secondAccepted = firstAccepted;
+			first = j;
+			firstAccepted = accepted;
+		}
+		else if (accepted < secondAccepted)
+		{
+			second = j;
+			secondAccepted = accepted;
+		}
+	}
+	if (length == 1)
+		second = first;
+
+	auto verify = [&](std::size_t i)
+	{
+		if (i + padded > size)
+		{
+			for (std::size_t j = 0; j < length; ++j)
+			{
+				if (!pattern[j].Matches(data[i + j]))
+					return false;
+			}
+			return true;
+		}
+
+		for (std::size_t j = 0; j < padded; j += 16)
+		{
+			const __m128i lanes = MatchLanes(_mm_loadu_si128((const __m128i*)(data + i + j)), _mm_loadu_si128((const __m128i*)&masks[j]),
+				_mm_loadu_si128((const __m128i*)&los[j]), _mm_loadu_si128((const __m128i*)&spans[j]));
+			if (_mm_movemask_epi8(lanes) != 0xFFFF)
+				return false;
+		}
+		return true;
+	};
+
+	const __m128i firstMask = _mm_set1_epi8((char)masks[first]);
+	const __m128i firstLo = _mm_set1_epi8((char)los[first]);
+	const __m128i firstSpan = _mm_set1_epi8((char)spans[first]);
+	const __m128i secondMask = _mm_set1_epi8((char)masks[second]);
+	const __m128i secondLo = _mm_set1_epi8((char)los[second]);
+	const __m128i secondSpan = _mm_set1_epi8((char)spans[second]);
+
+	//the filter loads of windows [i, i + 16) end before the last of those windows does
+	const std::size_t numWindows = size - length + 1;
+	std::size_t i = 0;
+	for (; i + 16 <= numWindows; i += 16)
+	{
+		const __m128i lanes = _mm_and_si128(
+			MatchLanes(_mm_loadu_si128((const __m128i*)(data + i + first)), firstMask, firstLo, firstSpan),
+			MatchLanes(_mm_loadu_si128((const __m128i*)(data + i + second)), secondMask, secondLo, secondSpan));
+		for (uint32_t candidates = (uint32_t)_mm_movemask_epi8(lanes); candidates; candidates &= candidates - 1)
+		{
+			const std::size_t index = i + LowestBit(candidates);
+			if (verify(index) && !report(index))
+				return;
+		}
+	}
+	for (; i < numWindows; ++i)
+	{
+		if (verify(i) && !report(i))
+			return;
+	}
+}
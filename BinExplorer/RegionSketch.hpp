@@ -0,0 +1,120 @@
+#pragma once
+
+//MinHash sketches of memory regions, so regions of two dumps can be paired by content when their bases differ
+//one permutation MinHash (Li, Owen & Zhang 2012): every 16 byte shingle is hashed once and kept if it is the smallest of its bin,
+//the fraction of bins two sketches agree on estimates the Jaccard similarity of their sets of shingles
+
+struct RegionSketch
+{
+	static constexpr int NumBins = 128;
+	static constexpr uint32_t EmptyBin = 0xFFFFFFFF;
+
+	std::array<uint32_t, NumBins> Bins;
+
+	bool IsEmpty() const
+	{
+		return std::all_of(Bins.cbegin(), Bins.cend(), [](uint32_t bin)
+		{
+			return bin == EmptyBin;
+		});
+	}
+};
+
+namespace RegionSketchDetail
+{
+	constexpr std::size_t ShingleSize = 16;
+	constexpr int RowsPerBand = 2; //64 bands, pairs of similarity 0.25 share a band with probability 0.98
+
+	inline uint64_t Load(const uint8_t* data)
+	{
+		uint64_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+}
+
+//shingles of a single repeated byte are left out, otherwise every mostly zeroed region would look alike
+inline RegionSketch ComputeRegionSketch(const uint8_t* data, std::size_t size)
+{
+	using namespace RegionSketchDetail;
+
+	RegionSketch sketch;
+	sketch.Bins.fill(RegionSketch::EmptyBin);
+	for (std::size_t i = 0; i + ShingleSize <= size; ++i)
+	{
+		const uint64_t low = Load(data + i);
+		const uint64_t high = Load(data + i + 8);
+		if (low == high && low == (low & 0xFF) * 0x0101010101010101ull)
+			continue;
+
+		const uint64_t hash = ((low * 0x9E3779B97F4A7C15ull) ^ high) * 0xC2B2AE3D27D4EB4Full;
+		uint32_t& bin = sketch.Bins[hash >> 57];
+		bin = std::min(bin, static_cast<uint32_t>(hash));
+	}
+	return sketch;
+}
+
+//estimated Jaccard similarity, 0 if either sketch is empty
+inline double EstimateSimilarity(const RegionSketch& a, const RegionSketch& b)
+{
+	int equal = 0;
+	int used = 0;
+	for (int i = 0; i < RegionSketch::NumBins; ++i)
+	{
+		if (a.Bins[i] == RegionSketch::EmptyBin && b.Bins[i] == RegionSketch::EmptyBin)
+			continue;
+		++used;
+		equal += a.Bins[i] == b.Bins[i];
+	}
+	return used == 0 ? 0.0 : static_cast<double>(equal) / used;
+}
+
+//pairs (i, j) of a[i] and b[j] agreeing on every bin of at least one band, so that similar sketches are found
+//without comparing all of a against all of b, bands of only empty bins don't count
+inline std::vector<std::pair<std::size_t, std::size_t>> FindSimilarSketchCandidates(const std::vector<RegionSketch>& a, const std::vector<RegionSketch>& b)
+{
+	using namespace RegionSketchDetail;
+
+	auto bandKey = [](const RegionSketch& sketch, int band, uint64_t& key)
+	{
+		key = static_cast<uint64_t>(band);
+		bool empty = true;
+		for (int row = 0; row < RowsPerBand; ++row)
+		{
+			const uint32_t bin = sketch.Bins[band * RowsPerBand + row];
+			empty = empty && bin == RegionSketch::EmptyBin;
+			key = (key ^ bin) * 0x9E3779B97F4A7C15ull;
+		}
+		return !empty;
+	};
+
+	std::unordered_map<uint64_t, std::vector<std::size_t>> buckets;
+	for (std::size_t i = 0; i < a.size(); ++i)
+	{
+		for (int band = 0; band < RegionSketch::NumBins / RowsPerBand; ++band)
+		{
+			uint64_t key;
+			if (bandKey(a[i], band, key))
+				buckets[key].push_back(i);
+		}
+	}
+
+	std::vector<std::pair<std::size_t, std::size_t>> candidates;
+	for (std::size_t j = 0; j < b.size(); ++j)
+	{
+		for (int band = 0; band < RegionSketch::NumBins / RowsPerBand; ++band)
+		{
+			uint64_t key;
+			if (!bandKey(b[j], band, key))
+				continue;
+			const auto it = buckets.find(key);
+			if (it == buckets.end())
+				continue;
+			for (std::size_t i : it->second)
+				candidates.emplace_back(i, j);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	return candidates;
+}
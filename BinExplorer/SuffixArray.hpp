@@ -0,0 +1,171 @@
+#pragma once
+
+//suffix arrays over memory dump regions (SA-IS, Nong, Zhang & Chan 2009), linear time and no extra memory beyond the array
+//the end of the text acts as a sentinel smaller than every byte, so no terminator has to be appended to the data
+
+namespace SuffixArrayDetail
+{
+	constexpr int32_t Empty = -1;
+
+	//bucket starts, or one past bucket ends, of every symbol
+	template <typename CharT>
+	void GetBuckets(const CharT* s, int32_t n, int32_t k, std::vector<int32_t>& buckets, bool ends)
+	{
+		buckets.assign(k, 0);
+		for (int32_t i = 0; i < n; ++i)
+			++buckets[s[i]];
+		int32_t sum = 0;
+		for (int32_t c = 0; c < k; ++c)
+		{
+			sum += buckets[c];
+			buckets[c] = ends ? sum : sum - buckets[c];
+		}
+	}
+
+	inline bool IsLms(const std::vector<bool>& isS, int32_t i)
+	{
+		return i > 0 && isS[i] && !isS[i - 1];
+	}
+
+	//sorts every suffix from the LMS suffixes already placed at the ends of their buckets
+	template <typename CharT>
+	void Induce(const CharT* s, int32_t* sa, int32_t n, int32_t k, const std::vector<bool>& isS, std::vector<int32_t>& buckets)
+	{
+		GetBuckets(s, n, k, buckets, false);
+		sa[buckets[s[n - 1]]++] = n - 1; //induced by the sentinel
+		for (int32_t i = 0; i < n; ++i)
+		{
+			const int32_t j = sa[i] - 1;
+			if (sa[i] > 0 && !isS[j])
+				sa[buckets[s[j]]++] = j;
+		}
+
+		GetBuckets(s, n, k, buckets, true);
+		for (int32_t i = n - 1; i >= 0; --i)
+		{
+			const int32_t j = sa[i] - 1;
+			if (sa[i] > 0 && isS[j])
+				sa[--buckets[s[j]]] = j;
+		}
+	}
+
+	template <typename CharT>
+	void Build(const CharT* s, int32_t* sa, int32_t n, int32_t k)
+	{
+		if (n == 0)
+			return;
+		if (n == 1)
+		{
+			sa[0] = 0;
+			return;
+		}
+
+		//S if smaller than the suffix after it, the last suffix is L since only the sentinel follows
+		std::vector<bool> isS(n, false);
+		for (int32_t i = n - 2; i >= 0; --i)
+			isS[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && isS[i + 1]);
+
+		//sort the LMS substrings
+		std::vector<int32_t> buckets;
+		GetBuckets(s, n, k, buckets, true);
+		std::fill(sa, sa + n, Empty);
+		for (int32_t i = 1; i < n; ++i)
+		{
+			if (IsLms(isS, i))
+				sa[--buckets[s[i]]] = i;
+		}
+		Induce(s, sa, n, k, isS, buckets);
+
+		//name them, equal substrings share a name
+		int32_t m = 0;
+		for (int32_t i = 0; i < n; ++i)
+		{
+			if (IsLms(isS, sa[i]))
+				sa[m++] = sa[i];
+		}
+		std::fill(sa + m, sa + n, Empty);
+		int32_t names = 0;
+		int32_t previous = Empty;
+		for (int32_t i = 0; i < m; ++i)
+		{
+			const int32_t position = sa[i];
+			bool different = false;
+			for (int32_t d = 0; ; ++d)
+			{
+				if (previous == Empty || position + d == n || previous + d == n
+					|| s[position + d] != s[previous + d] || isS[position + d] != isS[previous + d])
+				{
+					different = true; //reaching the sentinel always differs, it is unique
+					break;
+				}
+				if (d > 0 && (IsLms(isS, position + d) || IsLms(isS, previous + d)))
+					break;
+			}
+			if (different)
+			{
+				++names;
+				previous = position;
+			}
+			sa[m + position / 2] = names - 1; //LMS positions are at least two apart
+		}
+		for (int32_t i = n - 1, j = n - 1; i >= m; --i)
+		{
+			if (sa[i] != Empty)
+				sa[j--] = sa[i];
+		}
+
+		//sort the LMS suffixes by sorting the string of their names, recursing unless all names are unique
+		int32_t* const reduced = sa + n - m;
+		if (names < m)
+			Build(reduced, sa, m, names);
+		else
+		{
+			for (int32_t i = 0; i < m; ++i)
+				sa[reduced[i]] = i;
+		}
+
+		//back to text positions, then induce the full order from the sorted LMS suffixes
+		for (int32_t i = 1, j = 0; i < n; ++i)
+		{
+			if (IsLms(isS, i))
+				reduced[j++] = i;
+		}
+		for (int32_t i = 0; i < m; ++i)
+			sa[i] = reduced[sa[i]];
+		std::fill(sa + m, sa + n, Empty);
+		GetBuckets(s, n, k, buckets, true);
+		for (int32_t i = m - 1; i >= 0; --i)
+		{
+			const int32_t j = sa[i];
+			sa[i] = Empty;
+			sa[--buckets[s[j]]] = j;
+		}
+		Induce(s, sa, n, k, isS, buckets);
+	}
+}
+
+//data must be smaller than 2 GB
+inline std::vector<int32_t> BuildSuffixArray(const uint8_t* data, std::size_t size)
+{
+	std::vector<int32_t> sa(size);
+	SuffixArrayDetail::Build(data, sa.data(), static_cast<int32_t>(size), 256);
+	return sa;
+}
+
+//[first, last) of the suffixes starting with sequence, O(length * log(size))
+inline std::pair<std::size_t, std::size_t> FindInSuffixArray(const uint8_t* data, std::size_t size, const std::vector<int32_t>& sa,
+	const uint8_t* sequence, std::size_t length)
+{
+	//suffixes shorter than the sequence that equal its start sort before it, so they count as smaller
+	auto compare = [&](int32_t suffix) -> int
+	{
+		const std::size_t available = size - suffix;
+		const int order = std::memcmp(data + suffix, sequence, std::min(available, length));
+		if (order != 0)
+			return order;
+		return available < length ? -1 : 0;
+	};
+	const auto first = std::partition_point(sa.cbegin(), sa.cend(), [&](int32_t suffix) { return compare(suffix) < 0; });
+	const auto last = std::partition_point(first, sa.cend(), [&](int32_t suffix) { return compare(suffix) == 0; });
+	return { static_cast<std::size_t>(first - sa.cbegin()), static_cast<std::size_t>(last - sa.cbegin()) };
+}
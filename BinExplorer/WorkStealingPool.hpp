@@ -0,0 +1,81 @@
+#pragma once
+
+//runs a fixed set of tasks on a number of threads, the calling thread being worker 0
+//tasks are dealt out round robin in the order added, each worker runs its own in that order and once it runs out steals
+//from the back of the others, so add the largest first and whoever is stuck with slow tasks gets helped with the rest
+class WorkStealingPool
+{
+public:
+	using Task = std::function<void(unsigned worker)>;
+
+	explicit WorkStealingPool(unsigned numWorkers)
+	{
+		numWorkers = std::max(1u, numWorkers);
+		for (unsigned i = 0; i < numWorkers; ++i)
+			_Queues.emplace_back(new Queue);
+	}
+
+	unsigned GetNumWorkers() const
+	{
+		return static_cast<unsigned>(_Queues.size());
+	}
+
+	void Add(Task task)
+	{
+		_Queues[_NextQueue]->Tasks.push_back(std::move(task));
+		_NextQueue = (_NextQueue + 1) % _Queues.size();
+	}
+
+	//returns once every task has run, tasks must not add more
+	void Run()
+	{
+		std::vector<std::thread> threads;
+		for (unsigned i = 1; i < GetNumWorkers(); ++i)
+			threads.emplace_back([this, i] { Work(i); });
+		Work(0);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+private:
+	struct Queue
+	{
+		std::mutex Mutex;
+		std::deque<Task> Tasks;
+	};
+	std::vector<std::unique_ptr<Queue>> _Queues;
+	std::size_t _NextQueue = 0;
+
+	void Work(unsigned worker)
+	{
+		Task task;
+		while (Pop(worker, task) || Steal(worker, task))
+			task(worker);
+	}
+
+	bool Pop(unsigned worker, Task& task)
+	{
+		Queue& queue = *_Queues[worker];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (queue.Tasks.empty())
+			return false;
+		task = std::move(queue.Tasks.front());
+		queue.Tasks.pop_front();
+		return true;
+	}
+
+	bool Steal(unsigned worker, Task& task)
+	{
+		for (std::size_t i = 1; i < _Queues.size(); ++i)
+		{
+			Queue& victim = *_Queues[(worker + i) % _Queues.size()];
+			std::lock_guard<std::mutex> lock(victim.Mutex);
+			if (!victim.Tasks.empty())
+			{
+				task = std::move(victim.Tasks.back());
+				victim.Tasks.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+};
@@ -9,13 +9,30 @@
 #ifndef PCH_H
 #define PCH_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cctype>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <experimental/filesystem>
 #include <fstream>
+#include <functional>
+#include <immintrin.h>
+#include <intrin.h>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "dtl\dtl.hpp"
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "HiddenDragon.hpp"
+#include "LiveGameState.hpp"
 #include "MemoryScan.hpp"
 #include "Util.hpp"
 
@@ -51,6 +52,7 @@ static std::ofstream _messageFile("HiddenDragonMessages.txt");
 static std::ofstream _sendFile("HiddenDragonSent.txt");
 static TimedDump _requisitionDump("req");
 static TimedDump _deploymentDump("dep");
+static const char* const LiveGameStateLocationsFilename = "HiddenDragonLocations.txt";
 
 static const char* GetErrorString(HRESULT hr)
 {
@@ -253,7 +255,9 @@ static void OnSystemMessageReceived(DPID toPlayer, const DPMSG_GENERIC* sysMessa
 		{
 			SendFakeServerSetup();
 
-			AttachToCloseCombat();
+			//every remote player created lands here, the poll thread only needs starting with the first
+			if (AttachToCloseCombat() && !IsLiveGameStateRunning())
+				StartLiveGameState(LoadLiveGameStateLocations(LiveGameStateLocationsFilename));
 		}
 		break;
 	}
@@ -438,6 +442,17 @@ static void OnMainLoop()
 	}
 }
 
+//lines typed into the console are value scanner commands, e.g. "findany 120" then "narrow decreased", see "help"
+//runs beside the main loop until "quit" or the console closes, there is nothing to wait for at exit
+static void RunConsole()
+{
+	for (std::string line; std::getline(std::cin, line); )
+	{
+		if (!ExecuteMemoryCommand(line))
+			break;
+	}
+}
+
 static int RunMainLoop()
 {
 	for (std::vector<uint8_t> messageBuffer; _running; messageBuffer.clear())
@@ -481,6 +496,7 @@ static int RunMainLoop()
 
 static void OnProgramExit()
 {
+	StopLiveGameState();
 	DetachFromCloseCombat();
 
 	if (_directPlay)
@@ -551,6 +567,10 @@ int main()
 		std::cerr << "This is a critical error, bot won't be able to function without reading CC3.exe process memory.\n";
 		return 12;
 	}
+	if (IsClient())
+		StartLiveGameState(LoadLiveGameStateLocations(LiveGameStateLocationsFilename));
+
+	std::thread(RunConsole).detach();
 
 	return RunMainLoop();
 }
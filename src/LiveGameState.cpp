@@ -0,0 +1,164 @@
+#include "pch.h"
+
+#include "LiveGameState.hpp"
+
+static LiveGameStateLocations _locations;
+static std::thread _pollThread;
+static std::atomic<bool> _polling(false);
+
+//readers atomically copy _published, the poll thread fills a new snapshot every poll and swaps it in
+//never reusing one keeps a reader that still holds an old snapshot from seeing it change underneath
+static std::shared_ptr<const LiveGameSnapshot> _published;
+static uint64_t _version;
+
+LiveGameStateLocations LoadLiveGameStateLocations(const std::string& filename)
+{
+	LiveGameStateLocations locations;
+	std::ifstream is(filename);
+	std::string line;
+	while (std::getline(is, line))
+	{
+		std::istringstream fields(line);
+		std::string name;
+		if (!(fields >> name) || name[0] == '#')
+			continue;
+
+		if (name == "Rate")
+		{
+			fields >> locations.Rate;
+			continue;
+		}
+
+		PointerPath* path = nullptr;
+		if (name == "RussianSoldiers")
+			path = &locations.RussianSoldiers;
+		else if (name == "RussianVehicles")
+			path = &locations.RussianVehicles;
+		else if (name == "RussianTeams")
+			path = &locations.RussianTeams;
+		else if (name == "GermanSoldiers")
+			path = &locations.GermanSoldiers;
+		else if (name == "GermanVehicles")
+			path = &locations.GermanVehicles;
+		else if (name == "GermanTeams")
+			path = &locations.GermanTeams;
+		else
+		{
+			std::cerr << "Unknown structure " << name << " in " << filename << std::endl;
+			continue;
+		}
+
+		fields >> path->Anchor;
+		std::string offset;
+		while (fields >> offset)
+			path->Offsets.push_back(static_cast<int32_t>(strtol(offset.c_str(), nullptr, 0)));
+	}
+	return locations;
+}
+
+template <typename T, std::size_t N>
+static void AddRead(std::vector<MemoryRead>& reads, std::vector<bool*>& flags, const PointerPath& path, T (&destination)[N], bool& has)
+{
+	has = false;
+	if (path.Anchor.empty() || path.Address == 0)
+		return;
+
+	reads.push_back({ path.Address, destination, sizeof(destination), false });
+	flags.push_back(&has);
+}
+
+static bool Poll(LiveGameSnapshot& snapshot)
+{
+	std::vector<PointerPath*> paths;
+	for (PointerPath* path : { &_locations.RussianSoldiers, &_locations.RussianVehicles, &_locations.RussianTeams,
+		&_locations.GermanSoldiers, &_locations.GermanVehicles, &_locations.GermanTeams })
+	{
+		if (!path->Anchor.empty())
+			paths.push_back(path);
+	}
+	if (paths.empty())
+		return false;
+
+	//normally a single batched guard check, the paths are only walked again if the game moved something
+	ResolvePointerPaths(paths);
+
+	std::vector<MemoryRead> reads;
+	std::vector<bool*> flags;
+	AddRead(reads, flags, _locations.RussianSoldiers, snapshot.RussianSoldiers, snapshot.HasRussianSoldiers);
+	AddRead(reads, flags, _locations.RussianVehicles, snapshot.RussianVehicles, snapshot.HasRussianVehicles);
+	AddRead(reads, flags, _locations.RussianTeams, snapshot.RussianTeams, snapshot.HasRussianTeams);
+	AddRead(reads, flags, _locations.GermanSoldiers, snapshot.GermanSoldiers, snapshot.HasGermanSoldiers);
+	AddRead(reads, flags, _locations.GermanVehicles, snapshot.GermanVehicles, snapshot.HasGermanVehicles);
+	AddRead(reads, flags, _locations.GermanTeams, snapshot.GermanTeams, snapshot.HasGermanTeams);
+	ReadMemoryBatch(reads);
+
+	bool any = false;
+	for (std::size_t i = 0; i < reads.size(); ++i)
+	{
+		*flags[i] = reads[i].Ok;
+		any = any || reads[i].Ok;
+	}
+	snapshot.Time = std::chrono::steady_clock::now();
+	return any;
+}
+
+static void RunPollThread()
+{
+	const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(1.0 / std::max(_locations.Rate, 1.0)));
+	auto next = std::chrono::steady_clock::now();
+	while (_polling)
+	{
+		std::shared_ptr<LiveGameSnapshot> snapshot = std::make_shared<LiveGameSnapshot>();
+		if (Poll(*snapshot))
+		{
+			snapshot->Version = ++_version;
+			std::atomic_store(&_published, std::shared_ptr<const LiveGameSnapshot>(std::move(snapshot)));
+		}
+
+		//fixed schedule rather than fixed sleep so the rate doesn't drift with read cost, but never try to catch up
+		next += period;
+		const auto now = std::chrono::steady_clock::now();
+		if (next < now)
+			next = now;
+		std::this_thread::sleep_until(next);
+	}
+}
+
+void StartLiveGameState(const LiveGameStateLocations& locations)
+{
+	StopLiveGameState();
+
+	_locations = locations;
+	std::atomic_store(&_published, std::shared_ptr<const LiveGameSnapshot>());
+
+	//nothing located yet is the usual case, a thread polling nothing would only wake up 30 times a second for it
+	bool any = false;
+	for (const PointerPath* path : { &_locations.RussianSoldiers, &_locations.RussianVehicles, &_locations.RussianTeams,
+		&_locations.GermanSoldiers, &_locations.GermanVehicles, &_locations.GermanTeams })
+	{
+		any = any || !path->Anchor.empty();
+	}
+	if (!any)
+		return;
+
+	_polling = true;
+	_pollThread = std::thread(RunPollThread);
+}
+
+void StopLiveGameState()
+{
+	_polling = false;
+	if (_pollThread.joinable())
+		_pollThread.join();
+}
+
+bool IsLiveGameStateRunning()
+{
+	return _pollThread.joinable();
+}
+
+std::shared_ptr<const LiveGameSnapshot> GetLiveGameState()
+{
+	return std::atomic_load(&_published);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "GameData.hpp"
+#include "MemoryScan.hpp"
+
+//where the battle structures live inside CC3.exe
+//a path with an empty Anchor is not read, all of them are unset until located
+struct LiveGameStateLocations
+{
+	PointerPath RussianSoldiers; //SoldierData[MaxSoldiersPerSide]
+	PointerPath RussianVehicles; //VehicleData[MaxVehiclesPerSide]
+	PointerPath RussianTeams; //TeamData[MaxTeamsPerSide]
+	PointerPath GermanSoldiers;
+	PointerPath GermanVehicles;
+	PointerPath GermanTeams;
+	double Rate = 30; //polls per second
+};
+
+//one poll of the game, never modified once published
+struct LiveGameSnapshot
+{
+	uint64_t Version; //increases by one with every published snapshot
+	std::chrono::steady_clock::time_point Time;
+
+	bool HasRussianSoldiers;
+	bool HasRussianVehicles;
+	bool HasRussianTeams;
+	bool HasGermanSoldiers;
+	bool HasGermanVehicles;
+	bool HasGermanTeams;
+
+	SoldierData RussianSoldiers[MaxSoldiersPerSide];
+	VehicleData RussianVehicles[MaxVehiclesPerSide];
+	TeamData RussianTeams[MaxTeamsPerSide];
+	SoldierData GermanSoldiers[MaxSoldiersPerSide];
+	VehicleData GermanVehicles[MaxVehiclesPerSide];
+	TeamData GermanTeams[MaxTeamsPerSide];
+};
+
+//lines of "<structure> <anchor> <offset>..." or "Rate <hz>", offsets may be given in hex with 0x
+//a missing file leaves everything unset
+LiveGameStateLocations LoadLiveGameStateLocations(const std::string& filename);
+
+//polls on a background thread, must be attached to CC3.exe
+//no thread is started when every path is unset, GetLiveGameState then stays nullptr
+void StartLiveGameState(const LiveGameStateLocations& locations);
+void StopLiveGameState();
+//whether polling, i.e. started with at least one path set and not stopped since
+bool IsLiveGameStateRunning();
+//latest snapshot, nullptr until the first poll has completed
+//cheap enough to call every tick, keep the pointer for as long as the data is needed
+std::shared_ptr<const LiveGameSnapshot> GetLiveGameState();
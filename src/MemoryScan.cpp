@@ -3,9 +3,16 @@
 
 #include "pch.h"
 
+#include "MemoryScan.hpp"
+#include "PointerScan.hpp"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <math.h>
+#include <type_traits>
+#include <emmintrin.h>
+#include <intrin.h>
 
 
 #define REGION_ITERATOR_DONE    (1UL << 0)
@@ -29,8 +36,29 @@ int   region_iterator_done(struct region_iterator *);
 void *region_iterator_memory(struct region_iterator *);
 void  region_iterator_destroy(struct region_iterator *);
 
+struct region_map;
+void  region_map_init(struct region_map *, os_handle, double);
+void  region_map_refresh(struct region_map *);
+void  region_map_update(struct region_map *);
+void  region_map_refresh_at(struct region_map *, uintptr_t);
+const struct region_map_entry *region_map_find(struct region_map *, uintptr_t);
+size_t region_map_read(struct region_map *, uintptr_t, void *, size_t);
+struct read_request;
+void  region_map_read_batch(struct region_map *, struct read_request *, size_t);
+void  region_map_destroy(struct region_map *);
+
+struct region_prefetcher;
+int   region_prefetcher_init(struct region_prefetcher *, struct region_map *, unsigned long);
+int   region_prefetcher_next(struct region_prefetcher *);
+int   region_prefetcher_done(struct region_prefetcher *);
+void *region_prefetcher_memory(struct region_prefetcher *);
+void  region_prefetcher_destroy(struct region_prefetcher *);
+
+size_t      os_read_memory(os_handle, uintptr_t, void *, size_t);
+
 int         os_write_memory(os_handle, uintptr_t, void *, size_t);
 void        os_sleep(double);
+double      os_time(void);
 os_handle   os_process_open(os_pid);
 void        os_process_close(os_handle);
 const char *os_last_error(void);
@@ -39,6 +67,8 @@ void os_thread_start(struct os_thread *, struct memdig *);
 void os_thread_join(struct os_thread *);
 void os_mutex_lock(struct os_thread *);
 void os_mutex_unlock(struct os_thread *);
+void os_mutex_wait(struct os_thread *, double);
+void os_thread_wake(struct os_thread *);
 #endif
 
 struct memdig;
@@ -47,6 +77,7 @@ static void memdig_locker(struct memdig *);
 
 #include <process.h>
 #include <windows.h>
+#include <mmsystem.h>
 #include <tlhelp32.h>
 
 typedef HANDLE os_handle;
@@ -116,6 +147,28 @@ struct region_iterator {
 	size_t bufsize;
 };
 
+static unsigned long
+region_protect_flags(DWORD protect)
+{
+	switch (protect) {
+	case PAGE_EXECUTE:
+		return REGION_ITERATOR_EXECUTE;
+	case PAGE_EXECUTE_READ:
+		return REGION_ITERATOR_READ | REGION_ITERATOR_EXECUTE;
+	case PAGE_EXECUTE_READWRITE:
+		return REGION_ITERATOR_READ | REGION_ITERATOR_WRITE | REGION_ITERATOR_EXECUTE;
+	case PAGE_EXECUTE_WRITECOPY:
+		return REGION_ITERATOR_READ | REGION_ITERATOR_WRITE | REGION_ITERATOR_EXECUTE;
+	case PAGE_READWRITE:
+		return REGION_ITERATOR_READ | REGION_ITERATOR_WRITE;
+	case PAGE_READONLY:
+		return REGION_ITERATOR_READ;
+	case PAGE_WRITECOPY:
+		return REGION_ITERATOR_READ | REGION_ITERATOR_WRITE;
+	}
+	return 0;
+}
+
 static int
 region_iterator_next(struct region_iterator *i)
 {
@@ -128,36 +181,7 @@ region_iterator_next(struct region_iterator *i)
 				i->size = info->RegionSize;
 				i->base = (uintptr_t)info->AllocationBase;
 				i->actualBase = (uintptr_t)info->BaseAddress;
-				switch (info->AllocationProtect) {
-				case PAGE_EXECUTE:
-					i->flags |= REGION_ITERATOR_EXECUTE;
-					break;
-				case PAGE_EXECUTE_READ:
-					i->flags |= REGION_ITERATOR_READ;
-					i->flags |= REGION_ITERATOR_EXECUTE;
-					break;
-				case PAGE_EXECUTE_READWRITE:
-					i->flags |= REGION_ITERATOR_READ;
-					i->flags |= REGION_ITERATOR_WRITE;
-					i->flags |= REGION_ITERATOR_EXECUTE;
-					break;
-				case PAGE_EXECUTE_WRITECOPY:
-					i->flags |= REGION_ITERATOR_READ;
-					i->flags |= REGION_ITERATOR_WRITE;
-					i->flags |= REGION_ITERATOR_EXECUTE;
-					break;
-				case PAGE_READWRITE:
-					i->flags |= REGION_ITERATOR_READ;
-					i->flags |= REGION_ITERATOR_WRITE;
-					break;
-				case PAGE_READONLY:
-					i->flags |= REGION_ITERATOR_READ;
-					break;
-				case PAGE_WRITECOPY:
-					i->flags |= REGION_ITERATOR_READ;
-					i->flags |= REGION_ITERATOR_WRITE;
-					break;
-				}
+				i->flags = region_protect_flags(info->AllocationProtect);
 				break;
 			}
 		}
@@ -179,6 +203,18 @@ region_iterator_init(struct region_iterator *i, os_handle process)
 	return region_iterator_next(i);
 }
 
+/* Returns the number of bytes actually read, 0 on failure. A partial
+ * read (e.g. guard page in the middle of a region) still counts. */
+static size_t
+os_read_memory(os_handle target, uintptr_t base, void *buf, size_t bufsize)
+{
+	SIZE_T actual = 0;
+	const BOOL result = ReadProcessMemory(target, (void *)base, buf, bufsize, &actual);
+	if (!result && actual == 0)
+		return 0;
+	return actual;
+}
+
 static const void *
 region_iterator_memory(struct region_iterator *i)
 {
@@ -187,14 +223,10 @@ region_iterator_memory(struct region_iterator *i)
 		i->bufsize = i->size;
 		i->buf = malloc(i->bufsize);
 	}
-	SIZE_T actual;
-	void *base = (void *)i->actualBase;
-	const BOOL result = ReadProcessMemory(i->process, base, i->buf, i->size, &actual);
-
-	if (actual > 0 && actual < i->size)
-		i->size = actual;
-	else if (!result)
+	const size_t actual = os_read_memory(i->process, i->actualBase, i->buf, i->size);
+	if (actual == 0)
 		return nullptr;
+	i->size = actual;
  
 	return i->buf;
 }
@@ -221,6 +253,15 @@ os_sleep(double seconds)
 	Sleep(ms);
 }
 
+static double
+os_time(void)
+{
+	LARGE_INTEGER frequency, now;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart / (double)frequency.QuadPart;
+}
+
 static os_handle
 os_process_open(os_pid id)
 {
@@ -257,6 +298,7 @@ os_last_error(void)
 struct os_thread {
 	HANDLE thread;
 	CRITICAL_SECTION mutex;
+	CONDITION_VARIABLE wake;
 };
 
 static unsigned __stdcall
@@ -271,6 +313,7 @@ static void
 os_thread_start(struct os_thread *t, struct memdig *m)
 {
 	InitializeCriticalSection(&t->mutex);
+	InitializeConditionVariable(&t->wake);
 	t->thread = (HANDLE)_beginthreadex(0, 0, os_stub, m, 0, 0);
 }
 
@@ -293,6 +336,21 @@ os_mutex_unlock(struct os_thread *t)
 	LeaveCriticalSection(&t->mutex);
 }
 
+/* Releases the mutex until woken or the timeout passes; negative waits
+ * forever. Rounds up so a wakeup never comes before the timeout. */
+static void
+os_mutex_wait(struct os_thread *t, double seconds)
+{
+	DWORD ms = seconds < 0 ? INFINITE : (DWORD)(seconds * 1000 + 0.999);
+	SleepConditionVariableCS(&t->wake, &t->mutex, ms);
+}
+
+static void
+os_thread_wake(struct os_thread *t)
+{
+	WakeConditionVariable(&t->wake);
+}
+
 static int
 process_iterator_done(struct process_iterator *i)
 {
@@ -305,6 +363,415 @@ region_iterator_done(struct region_iterator *i)
 	return !!(i->flags & REGION_ITERATOR_DONE);
 }
 
+/* Snapshot of the committed regions of a process, sorted by address. It is
+ * built with one VirtualQueryEx walk and then shared by every scan, dump
+ * and point read. A full walk happens again only once the snapshot is
+ * older than max_age; when a read shows that the layout changed, just the
+ * allocation around the failing address is queried again. Lookups are
+ * binary searches. Guarded by a lock since point reads may come from
+ * other threads. */
+#define REGION_MAP_MAX_AGE 1.0
+
+struct region_map_entry {
+	uintptr_t base;
+	uintptr_t actualBase;
+	size_t size;
+	unsigned long flags;
+};
+
+struct region_map {
+	os_handle process;
+	struct region_map_entry *entries;
+	size_t count;
+	size_t capacity;
+	double refreshed;
+	double max_age;
+	CRITICAL_SECTION lock;
+};
+
+static void
+region_map_insert(struct region_map *map, size_t at, const struct region_map_entry *e)
+{
+	if (map->count == map->capacity) {
+		size_t capacity = map->capacity ? map->capacity * 2 : 1024;
+		void *entries = realloc(map->entries, capacity * sizeof(map->entries[0]));
+		if (!entries)
+			return; // region stays unknown; reads there will try again
+		map->entries = (region_map_entry *)entries;
+		map->capacity = capacity;
+	}
+	memmove(map->entries + at + 1, map->entries + at, (map->count - at) * sizeof(map->entries[0]));
+	map->entries[at] = *e;
+	map->count++;
+}
+
+/* Index of the first entry ending after addr. */
+static size_t
+region_map_lower(const struct region_map *map, uintptr_t addr)
+{
+	size_t lo = 0;
+	size_t hi = map->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const struct region_map_entry *e = &map->entries[mid];
+		if (e->actualBase + e->size <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void
+region_map_refresh_locked(struct region_map *map)
+{
+	map->count = 0;
+	struct region_iterator it[1];
+	region_iterator_init(it, map->process);
+	for (; !region_iterator_done(it); region_iterator_next(it)) {
+		struct region_map_entry e;
+		e.base = it->base;
+		e.actualBase = it->actualBase;
+		e.size = it->size;
+		e.flags = it->flags;
+		region_map_insert(map, map->count, &e);
+	}
+	region_iterator_destroy(it);
+	map->refreshed = os_time();
+}
+
+static void
+region_map_init(struct region_map *map, os_handle process, double max_age)
+{
+	map->process = process;
+	map->entries = NULL;
+	map->count = 0;
+	map->capacity = 0;
+	map->max_age = max_age;
+	InitializeCriticalSection(&map->lock);
+	region_map_refresh_locked(map);
+}
+
+static void
+region_map_refresh(struct region_map *map)
+{
+	EnterCriticalSection(&map->lock);
+	region_map_refresh_locked(map);
+	LeaveCriticalSection(&map->lock);
+}
+
+static void
+region_map_update(struct region_map *map)
+{
+	EnterCriticalSection(&map->lock);
+	if (os_time() - map->refreshed > map->max_age)
+		region_map_refresh_locked(map);
+	LeaveCriticalSection(&map->lock);
+}
+
+/* Requeries only the allocation (or free range) containing addr and
+ * splices the result into the snapshot. */
+static void
+region_map_refresh_at_locked(struct region_map *map, uintptr_t addr)
+{
+	MEMORY_BASIC_INFORMATION info[1];
+	if (!VirtualQueryEx(map->process, (void *)addr, info, sizeof(info)))
+		return;
+
+	const int is_free = info->State != MEM_COMMIT && info->State != MEM_RESERVE;
+	const uintptr_t allocation = (uintptr_t)info->AllocationBase;
+	uintptr_t start = is_free ? (uintptr_t)info->BaseAddress : allocation;
+	uintptr_t end = (uintptr_t)info->BaseAddress + info->RegionSize;
+
+	std::vector<struct region_map_entry> pieces;
+	if (!is_free) {
+		for (uintptr_t p = allocation;; p = end) {
+			if (!VirtualQueryEx(map->process, (void *)p, info, sizeof(info)) ||
+				(uintptr_t)info->AllocationBase != allocation ||
+				info->State == MEM_FREE)
+				break;
+			end = (uintptr_t)info->BaseAddress + info->RegionSize;
+			if (info->State == MEM_COMMIT) {
+				struct region_map_entry e;
+				e.base = allocation;
+				e.actualBase = (uintptr_t)info->BaseAddress;
+				e.size = info->RegionSize;
+				e.flags = region_protect_flags(info->AllocationProtect);
+				pieces.push_back(e);
+			}
+		}
+	}
+
+	size_t first = region_map_lower(map, start);
+	size_t last = first;
+	while (last < map->count && map->entries[last].actualBase < end)
+		last++;
+	memmove(map->entries + first, map->entries + last, (map->count - last) * sizeof(map->entries[0]));
+	map->count -= last - first;
+	for (size_t i = 0; i < pieces.size(); i++)
+		region_map_insert(map, first + i, &pieces[i]);
+}
+
+static void
+region_map_refresh_at(struct region_map *map, uintptr_t addr)
+{
+	EnterCriticalSection(&map->lock);
+	region_map_refresh_at_locked(map, addr);
+	LeaveCriticalSection(&map->lock);
+}
+
+/* The returned entry points into map->entries and is only valid while
+ * map->lock is held; prefer region_map_read for reads. */
+static const struct region_map_entry *
+region_map_find(struct region_map *map, uintptr_t addr)
+{
+	size_t i = region_map_lower(map, addr);
+	if (i < map->count && map->entries[i].actualBase <= addr)
+		return &map->entries[i];
+	return NULL;
+}
+
+/* Point read through the snapshot. An address outside the known regions
+ * or a failed read triggers a local refresh and one retry. Never rewalks
+ * the whole map, that is left to scans and dumps (region_map_update), so
+ * pollers don't pay for it on every read. Returns the number of bytes
+ * read. */
+static size_t
+region_map_read(struct region_map *map, uintptr_t addr, void *buf, size_t size)
+{
+	for (int attempt = 0; attempt < 2; attempt++) {
+		EnterCriticalSection(&map->lock);
+		if (attempt)
+			region_map_refresh_at_locked(map, addr);
+		const int known = region_map_find(map, addr) != NULL;
+		LeaveCriticalSection(&map->lock);
+		if (!known)
+			continue;
+		size_t actual = os_read_memory(map->process, addr, buf, size);
+		if (actual)
+			return actual;
+	}
+	return 0;
+}
+
+/* Many small reads issued together. Requests are sorted by address and
+ * neighbours in the same region closer than READ_BATCH_MAX_GAP are served
+ * by a single ReadProcessMemory into a scratch span. A span that fails is
+ * retried request by request through region_map_read. */
+#define READ_BATCH_MAX_GAP  4096
+#define READ_BATCH_MAX_SPAN (1 << 20)
+
+struct read_request {
+	uintptr_t addr;
+	void *buf;
+	size_t size;
+	size_t actual; // filled in by region_map_read_batch
+};
+
+static void
+region_map_read_batch(struct region_map *map, struct read_request *reqs, size_t count)
+{
+	std::vector<size_t> order(count);
+	for (size_t i = 0; i < count; i++) {
+		order[i] = i;
+		reqs[i].actual = 0;
+	}
+	std::sort(order.begin(), order.end(), [reqs](size_t a, size_t b) {
+		return reqs[a].addr < reqs[b].addr;
+	});
+
+	std::vector<unsigned char> span;
+	for (size_t first = 0; first < count;) {
+		const struct read_request *head = &reqs[order[first]];
+		EnterCriticalSection(&map->lock);
+		const struct region_map_entry *e = region_map_find(map, head->addr);
+		const uintptr_t limit = e ? e->actualBase + e->size : 0;
+		LeaveCriticalSection(&map->lock);
+
+		uintptr_t end = head->addr + head->size;
+		size_t last = first + 1;
+		while (e && last < count) {
+			const struct read_request *r = &reqs[order[last]];
+			const uintptr_t r_end = std::max<uintptr_t>(end, r->addr + r->size);
+			if (r->addr > end + READ_BATCH_MAX_GAP || r_end > limit ||
+				r_end - head->addr > READ_BATCH_MAX_SPAN)
+				break;
+			end = r_end;
+			last++;
+		}
+
+		size_t actual = 0;
+		if (e && end <= limit) {
+			span.resize(end - head->addr);
+			actual = os_read_memory(map->process, head->addr, span.data(), span.size());
+		}
+		if (actual == end - head->addr) {
+			for (size_t i = first; i < last; i++) {
+				struct read_request *r = &reqs[order[i]];
+				memcpy(r->buf, span.data() + (r->addr - head->addr), r->size);
+				r->actual = r->size;
+			}
+		} else {
+			for (size_t i = first; i < last; i++) {
+				struct read_request *r = &reqs[order[i]];
+				r->actual = region_map_read(map, r->addr, r->buf, r->size);
+			}
+		}
+		first = last;
+	}
+}
+
+static void
+region_map_destroy(struct region_map *map)
+{
+	DeleteCriticalSection(&map->lock);
+	free(map->entries);
+	map->entries = NULL;
+	map->count = map->capacity = 0;
+}
+
+/* Double-buffered region iterator. A helper thread walks the regions and
+ * copies region N+1 into the spare buffer while the caller is still busy
+ * with region N, so the cross-process copy overlaps with scanning/dumping.
+ * Public fields mirror struct region_iterator. Regions whose flags match
+ * any bit in skip are never read. */
+struct region_prefetcher {
+	uintptr_t base;
+	uintptr_t actualBase;
+	size_t size;
+	unsigned long flags;
+
+	// private
+	struct region_map_entry *regions; // snapshot taken at init
+	size_t count;
+	struct region_slot {
+		uintptr_t base;
+		uintptr_t actualBase;
+		size_t size;
+		unsigned long flags;
+		void *buf;
+		size_t bufsize;
+		DWORD error; // 0 if buf holds the region
+	} slots[2];
+	struct region_slot *current;
+	int consumer_slot;
+	unsigned long skip;
+	os_handle process;
+	HANDLE filled; // slots ready for the caller
+	HANDLE empty;  // slots ready for the helper thread
+	HANDLE thread;
+	volatile LONG stop;
+};
+
+static unsigned __stdcall
+region_prefetcher_stub(void *arg)
+{
+	struct region_prefetcher *p = (region_prefetcher *)arg;
+	int producer_slot = 0;
+	for (size_t n = 0;; n++) {
+		while (n < p->count && (p->regions[n].flags & p->skip))
+			n++;
+		WaitForSingleObject(p->empty, INFINITE);
+		if (p->stop)
+			break;
+
+		struct region_prefetcher::region_slot *s = &p->slots[producer_slot];
+		producer_slot ^= 1;
+		if (n == p->count) {
+			s->flags = REGION_ITERATOR_DONE;
+			ReleaseSemaphore(p->filled, 1, 0);
+			break;
+		}
+
+		s->base = p->regions[n].base;
+		s->actualBase = p->regions[n].actualBase;
+		s->size = p->regions[n].size;
+		s->flags = p->regions[n].flags;
+		s->error = 0;
+		if (s->bufsize < s->size) {
+			free(s->buf);
+			s->bufsize = s->size;
+			s->buf = malloc(s->bufsize);
+		}
+		const size_t actual = s->buf ? os_read_memory(p->process, s->actualBase, s->buf, s->size) : 0;
+		if (actual == 0)
+			s->error = s->buf ? GetLastError() : ERROR_NOT_ENOUGH_MEMORY;
+		else
+			s->size = actual;
+		ReleaseSemaphore(p->filled, 1, 0);
+	}
+	_endthreadex(0);
+	return 0;
+}
+
+static int
+region_prefetcher_next(struct region_prefetcher *p)
+{
+	if (p->current)
+		ReleaseSemaphore(p->empty, 1, 0); // caller is done with this buffer
+	WaitForSingleObject(p->filled, INFINITE);
+	p->current = &p->slots[p->consumer_slot];
+	p->consumer_slot ^= 1;
+	p->base = p->current->base;
+	p->actualBase = p->current->actualBase;
+	p->size = p->current->size;
+	p->flags = p->current->flags;
+	return !(p->flags & REGION_ITERATOR_DONE);
+}
+
+static int
+region_prefetcher_init(struct region_prefetcher *p, struct region_map *map, unsigned long skip)
+{
+	std::memset(p, 0, sizeof(*p));
+	p->process = map->process;
+	p->skip = skip;
+	region_map_update(map);
+	EnterCriticalSection(&map->lock);
+	p->count = map->count;
+	p->regions = (region_map_entry *)malloc(p->count * sizeof(p->regions[0]) + 1);
+	if (!p->regions)
+		p->count = 0;
+	else
+		memcpy(p->regions, map->entries, p->count * sizeof(p->regions[0]));
+	LeaveCriticalSection(&map->lock);
+	p->filled = CreateSemaphore(0, 0, 0x7fffffff, 0);
+	p->empty = CreateSemaphore(0, 2, 0x7fffffff, 0);
+	p->thread = (HANDLE)_beginthreadex(0, 0, region_prefetcher_stub, p, 0, 0);
+	return region_prefetcher_next(p);
+}
+
+static int
+region_prefetcher_done(struct region_prefetcher *p)
+{
+	return !!(p->flags & REGION_ITERATOR_DONE);
+}
+
+static const void *
+region_prefetcher_memory(struct region_prefetcher *p)
+{
+	if (p->current->error) {
+		SetLastError(p->current->error); // so os_last_error() reports the helper's failure
+		return nullptr;
+	}
+	return p->current->buf;
+}
+
+static void
+region_prefetcher_destroy(struct region_prefetcher *p)
+{
+	InterlockedExchange(&p->stop, 1);
+	ReleaseSemaphore(p->empty, 2, 0); // wake the helper if it waits for a buffer
+	WaitForSingleObject(p->thread, INFINITE);
+	CloseHandle(p->thread);
+	CloseHandle(p->filled);
+	CloseHandle(p->empty);
+	free(p->slots[0].buf);
+	free(p->slots[1].buf);
+	free(p->regions);
+	p->slots[0].buf = p->slots[1].buf = NULL;
+	p->regions = NULL;
+}
+
 static enum loglevel {
 	LOGLEVEL_DEBUG = -2,
 	LOGLEVEL_INFO = -1,
@@ -372,7 +839,9 @@ struct value {
 	} value;
 };
 
-#define VALUE_SIZE(v) ("bbcceeiiei"[(v).type] - 'a')
+#define VALUE_TYPE_COUNT (VALUE_F64 + 1)
+#define VALUE_TYPE_SIZE(t) ("bbcceeiiei"[(t)] - 'a')
+#define VALUE_SIZE(v) VALUE_TYPE_SIZE((v).type)
 
 enum value_parse_result {
 	VALUE_PARSE_SUCCESS,
@@ -617,48 +1086,198 @@ value_compare(const struct value *a, const struct value *b)
 	abort();
 }
 
+/* Hits are kept per region in blocks: the region base is stored once,
+ * followed by u32 offsets and a raw value array of the block's type, so an
+ * entry costs 4 + sizeof(value) bytes. Blocks are never resized; when one
+ * fills up a new block twice its size is chained for the same region, so
+ * growth never copies entries. Offsets within a block are ascending. */
+#define WATCHLIST_BLOCK_MIN 64
+#define WATCHLIST_BLOCK_MAX (1 << 20)
+
+struct watchlist_block {
+	struct watchlist_block *next;
+	uintptr_t base;
+	enum value_type type;
+	size_t count;
+	size_t capacity;
+	uint32_t *offsets;
+	unsigned char *values;
+};
+
 struct watchlist {
 	os_handle process;
 	size_t count;
-	size_t size;
-	struct wtf {
-		uintptr_t addr;
-		struct value prev;
-	} *list;
+	struct watchlist_block *head;
+	struct watchlist_block *tail;
+	struct watchlist_block *open[VALUE_TYPE_COUNT]; // last block appended to, per type
 };
 
+static struct watchlist_block *
+watchlist_block_new(struct watchlist *s, uintptr_t base, enum value_type type, size_t capacity)
+{
+	const size_t header = (sizeof(struct watchlist_block) + 15) & ~(size_t)15;
+	/* Rounded up so values of 8-byte types stay aligned for any capacity,
+	 * e.g. the odd counts watchlist_load hands us. */
+	const size_t offsets = (capacity * sizeof(uint32_t) + 7) & ~(size_t)7;
+	struct watchlist_block *b = (watchlist_block *)malloc(header + offsets + capacity * VALUE_TYPE_SIZE(type));
+	if (!b)
+		FATAL("out of memory for watchlist block\n");
+	b->next = NULL;
+	b->base = base;
+	b->type = type;
+	b->count = 0;
+	b->capacity = capacity;
+	b->offsets = (uint32_t *)((char *)b + header);
+	b->values = (unsigned char *)b->offsets + offsets;
+	if (s->tail)
+		s->tail->next = b;
+	else
+		s->head = b;
+	s->tail = b;
+	s->open[type] = b;
+	return b;
+}
+
 static void
 watchlist_init(struct watchlist *s, os_handle process)
 {
+	std::memset(s, 0, sizeof(*s));
 	s->process = process;
-	s->size = 4096;
-	s->count = 0;
-	s->list = (watchlist::wtf*)malloc(s->size * sizeof(s->list[0]));
 }
 
 static void
-watchlist_push(struct watchlist *s, uintptr_t a, const struct value *v)
+watchlist_push(struct watchlist *s, uintptr_t base, uint32_t offset, const struct value *v)
 {
-	if (s->count == s->size) {
-		s->size *= 2;
-		s->list = (watchlist::wtf*)realloc(s->list, s->size * sizeof(s->list[0]));
+	struct watchlist_block *b = s->open[v->type];
+	if (!b || b->base != base || b->count == b->capacity) {
+		size_t capacity = WATCHLIST_BLOCK_MIN;
+		if (b && b->base == base)
+			capacity = std::min<size_t>(b->capacity * 2, WATCHLIST_BLOCK_MAX);
+		b = watchlist_block_new(s, base, v->type, capacity);
 	}
-	s->list[s->count].addr = a;
-	s->list[s->count].prev = *v;
+	const unsigned size = VALUE_SIZE(*v);
+	b->offsets[b->count] = offset;
+	memcpy(b->values + b->count * size, &v->value, size);
+	b->count++;
 	s->count++;
 }
 
+static uintptr_t
+watchlist_addr(const struct watchlist_block *b, size_t i)
+{
+	return b->base + b->offsets[i];
+}
+
+static void
+watchlist_value(const struct watchlist_block *b, size_t i, struct value *v)
+{
+	value_read(v, b->type, b->values + i * VALUE_TYPE_SIZE(b->type));
+}
+
 static void
 watchlist_free(struct watchlist *s)
 {
-	free(s->list);
-	s->list = NULL;
+	struct watchlist_block *b = s->head;
+	while (b) {
+		struct watchlist_block *next = b->next;
+		free(b);
+		b = next;
+	}
+	s->head = s->tail = NULL;
+	std::memset(s->open, 0, sizeof(s->open));
+	s->count = 0;
 }
 
 static void
 watchlist_clear(struct watchlist *s)
 {
-	s->count = 0;
+	watchlist_free(s);
+}
+
+/* Binary watchlist file: the magic, then for each block a header with
+ * its base relative to an anchor, followed by the block's offsets and
+ * previous values exactly as they are held in memory. Loading against
+ * the anchor's new address is a couple of freads per block. */
+#define WATCHLIST_FILE_MAGIC "MDW1"
+
+struct watchlist_file_block {
+	uint32_t type;
+	uint32_t count;
+	int64_t base; // minus the anchor
+};
+
+static int
+watchlist_save(const struct watchlist *wl, const char *filename, uintptr_t anchor)
+{
+	FILE *f = fopen(filename, "wb");
+	if (!f)
+		return 0;
+	int ok = fwrite(WATCHLIST_FILE_MAGIC, 4, 1, f) == 1;
+	for (struct watchlist_block *b = wl->head; ok && b; b = b->next) {
+		if (!b->count)
+			continue;
+		struct watchlist_file_block h;
+		h.type = b->type;
+		h.count = (uint32_t)b->count;
+		h.base = (int64_t)b->base - (int64_t)anchor;
+		const unsigned size = VALUE_TYPE_SIZE(b->type);
+		ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+			fwrite(b->offsets, sizeof(uint32_t), b->count, f) == b->count &&
+			fwrite(b->values, size, b->count, f) == b->count;
+	}
+	return !fclose(f) && ok;
+}
+
+/* Whether a loaded block is one narrow can span: offsets strictly
+ * ascending and its last value inside the region now holding its base. */
+static int
+watchlist_block_valid(struct region_map *map, const struct watchlist_block *b, size_t count)
+{
+	for (size_t i = 1; i < count; i++)
+		if (b->offsets[i] <= b->offsets[i - 1])
+			return 0;
+	const uintptr_t end = b->base + b->offsets[count - 1] + VALUE_TYPE_SIZE(b->type);
+	EnterCriticalSection(&map->lock);
+	const struct region_map_entry *e = region_map_find(map, b->base);
+	if (!e) {
+		region_map_refresh_at_locked(map, b->base);
+		e = region_map_find(map, b->base);
+	}
+	const int inside = e && end <= e->actualBase + e->size;
+	LeaveCriticalSection(&map->lock);
+	return inside;
+}
+
+/* Replaces the contents of wl, which is left empty on failure. */
+static int
+watchlist_load(struct watchlist *wl, struct region_map *map, const char *filename, uintptr_t anchor)
+{
+	FILE *f = fopen(filename, "rb");
+	if (!f)
+		return 0;
+	watchlist_clear(wl);
+	char magic[4];
+	int ok = fread(magic, 4, 1, f) == 1 && !memcmp(magic, WATCHLIST_FILE_MAGIC, 4);
+	struct watchlist_file_block h;
+	while (ok && fread(&h, sizeof(h), 1, f) == 1) {
+		if (h.type >= VALUE_TYPE_COUNT || !h.count || h.count > WATCHLIST_BLOCK_MAX) {
+			ok = 0;
+			break;
+		}
+		const enum value_type type = (enum value_type)h.type;
+		struct watchlist_block *b = watchlist_block_new(wl, (uintptr_t)(anchor + h.base), type, h.count);
+		ok = fread(b->offsets, sizeof(uint32_t), h.count, f) == h.count &&
+			fread(b->values, VALUE_TYPE_SIZE(type), h.count, f) == h.count &&
+			watchlist_block_valid(map, b, h.count);
+		if (ok) {
+			b->count = h.count;
+			wl->count += h.count;
+		}
+	}
+	fclose(f);
+	if (!ok)
+		watchlist_clear(wl);
+	return ok;
 }
 
 /* Memory scanning */
@@ -669,13 +1288,28 @@ enum scan_op {
 	SCAN_OP_GT,
 	SCAN_OP_LTEG,
 	SCAN_OP_GTEQ,
+
+	/* Inclusive ranges, each reduced to a struct scan_range. */
+	SCAN_OP_BETWEEN,
+	SCAN_OP_NEAR,
+	SCAN_OP_WITHIN,
+
+	/* Relative to each entry's previous value, narrow only. With an
+	 * operand, increased/decreased mean "by exactly that amount". */
+	SCAN_OP_CHANGED,
+	SCAN_OP_UNCHANGED,
+	SCAN_OP_INCREASED,
+	SCAN_OP_DECREASED,
 };
 
+#define SCAN_OP_IS_RELATIVE(op) ((op) >= SCAN_OP_CHANGED)
+#define SCAN_OP_IS_RANGE(op) ((op) >= SCAN_OP_BETWEEN && (op) <= SCAN_OP_WITHIN)
+
 static int
 scan_op_parse(const char *s, enum scan_op *op)
 {
 	static const struct {
-		char name[3];
+		char name[12];
 		enum scan_op op;
 	} table[] = {
 		{"=", SCAN_OP_EQ},
@@ -683,6 +1317,13 @@ scan_op_parse(const char *s, enum scan_op *op)
 		{">", SCAN_OP_GT},
 		{"<=", SCAN_OP_LTEG},
 		{">=", SCAN_OP_GTEQ},
+		{"between", SCAN_OP_BETWEEN},
+		{"near", SCAN_OP_NEAR},
+		{"within", SCAN_OP_WITHIN},
+		{"changed", SCAN_OP_CHANGED},
+		{"unchanged", SCAN_OP_UNCHANGED},
+		{"increased", SCAN_OP_INCREASED},
+		{"decreased", SCAN_OP_DECREASED},
 	};
 	for (unsigned i = 0; i < sizeof(table) / sizeof(table[0]); i++)
 		if (strcmp(table[i].name, s) == 0) {
@@ -692,140 +1333,845 @@ scan_op_parse(const char *s, enum scan_op *op)
 	return 0;
 }
 
-static int
-scan(struct watchlist *wl, struct value *v, enum scan_op op)
-{
-	unsigned value_size = VALUE_SIZE(*v);
-	enum value_type type = v->type;
-	watchlist_clear(wl);
-	struct region_iterator it[1];
-	region_iterator_init(it, wl->process);
-	for (; !region_iterator_done(it); region_iterator_next(it)) {
-		const char *buf;
-		if ((buf = (const char*)region_iterator_memory(it))) {
-			size_t count = it->size / value_size;
-			for (size_t i = 0; i < count; i++) {
-				struct value read;
-				value_read(&read, type, buf + i * value_size);
-				int cmp = value_compare(&read, v);
-				int pass = 0;
-				switch (op) {
-				case SCAN_OP_EQ:
-					pass = cmp == 0;
-					break;
-				case SCAN_OP_LT:
-					pass = cmp < 0;
-					break;
-				case SCAN_OP_GT:
-					pass = cmp > 0;
-					break;
-				case SCAN_OP_LTEG:
-					pass = cmp <= 0;
-					break;
-				case SCAN_OP_GTEQ:
-					pass = cmp >= 0;
-					break;
-				}
-				if (pass) {
-					uintptr_t addr = it->base + i * value_size;
-					watchlist_push(wl, addr, &read);
-				}
-			}
-		}
-		else {
-			LOG_DEBUG("memory read failed [0x%016" PRIxPTR "]: %s\n",
-				it->base, os_last_error());
-		}
-	}
-	region_iterator_destroy(it);
-	return 1;
-}
-
-typedef void(*watchlist_visitor)(uintptr_t, const struct value *, void *);
+typedef void(*watchlist_visitor)(uintptr_t, uint32_t, const struct value *, void *);
 
+/* Reads the span covered by each block with a single read instead of
+ * walking every region of the process. Entries that cannot be read are
+ * visited with a NULL value. */
 static void
 watchlist_visit(struct watchlist *wl, watchlist_visitor f, void *arg)
 {
-	struct region_iterator it[1];
-	region_iterator_init(it, wl->process);
-	size_t n = 0;
-	for (; !region_iterator_done(it) && n < wl->count; region_iterator_next(it)) {
-		const char *buf = NULL;
-		uintptr_t base = it->base;
-		uintptr_t tail = base + it->size;
-		while (n < wl->count && wl->list[n].addr < base)
-			n++;
-		while (n < wl->count && wl->list[n].addr >= base && wl->list[n].addr < tail) {
-			if (!buf)
-				buf = (const char*)region_iterator_memory(it);
-			uintptr_t addr = wl->list[n].addr;
-			enum value_type type = wl->list[n].prev.type;
-			size_t offset = wl->list[n].addr - base;
-			if (buf) {
+	char *buf = NULL;
+	size_t bufsize = 0;
+	for (struct watchlist_block *b = wl->head; b; b = b->next) {
+		if (!b->count)
+			continue;
+		const unsigned size = VALUE_TYPE_SIZE(b->type);
+		const uint32_t first = b->offsets[0];
+		const size_t span = b->offsets[b->count - 1] - first + size;
+		if (bufsize < span) {
+			free(buf);
+			bufsize = span;
+			buf = (char *)malloc(bufsize);
+		}
+		const size_t actual = buf ? os_read_memory(wl->process, b->base + first, buf, span) : 0;
+		for (size_t n = 0; n < b->count; n++) {
+			const size_t offset = b->offsets[n] - first;
+			if (offset + size <= actual) {
 				struct value value;
-				value_read(&value, type, buf + offset);
-				f(addr, &value, arg);
+				value_read(&value, b->type, buf + offset);
+				f(b->base, b->offsets[n], &value, arg);
 			}
 			else {
-				f(addr, NULL, arg);
+				f(b->base, b->offsets[n], NULL, arg);
 			}
-			n++;
 		}
 	}
-	region_iterator_destroy(it);
+	free(buf);
 }
 
-struct narrow_visitor_state {
-	struct watchlist *wl;
-	struct value target;
-	enum scan_op op;
-};
+template <typename T>
+static T
+value_as(const struct value *v)
+{
+	switch (v->type) {
+	case VALUE_S8:
+		return (T)v->value.s8;
+	case VALUE_U8:
+		return (T)v->value.u8;
+	case VALUE_S16:
+		return (T)v->value.s16;
+	case VALUE_U16:
+		return (T)v->value.u16;
+	case VALUE_S32:
+		return (T)v->value.s32;
+	case VALUE_U32:
+		return (T)v->value.u32;
+	case VALUE_S64:
+		return (T)v->value.s64;
+	case VALUE_U64:
+		return (T)v->value.u64;
+	case VALUE_F32:
+		return (T)v->value.f32;
+	case VALUE_F64:
+		return (T)v->value.f64;
+	}
+	abort();
+}
 
-static void
-narrow_visitor(uintptr_t addr, const struct value *v, void *arg)
-{
-	char buf[64];
-	value_print(buf, sizeof(buf), v);
-	struct narrow_visitor_state *s = (narrow_visitor_state *)arg;
-	int cmp = value_compare(v, &s->target);
-	int pass = 0;
-	switch (s->op) {
-	case SCAN_OP_EQ:
-		pass = cmp == 0;
-		break;
-	case SCAN_OP_LT:
-		pass = cmp < 0;
-		break;
+/* Wrapping difference for integers, plain difference for floats. */
+template <typename T>
+static T
+value_delta(T a, T b, std::true_type)
+{
+	typedef typename std::make_unsigned<T>::type U;
+	return (T)(U)((U)a - (U)b);
+}
+
+template <typename T>
+static T
+value_delta(T a, T b, std::false_type)
+{
+	return a - b;
+}
+
+/* Converts the number in v to T, failing unless T holds it exactly.
+ * Floats take any number, rounding as needed. */
+template <typename T>
+static int
+value_fits(const struct value *v, T *out)
+{
+	typedef std::numeric_limits<T> limits;
+	if (v->type == VALUE_F32 || v->type == VALUE_F64) {
+		double d = value_as<double>(v);
+		if (!std::is_floating_point<T>::value &&
+			(d != floor(d) || d < (double)limits::lowest() || d > (double)limits::max()))
+			return 0;
+		*out = (T)d;
+	}
+	else if (v->type == VALUE_U64 || v->type == VALUE_U32 || v->type == VALUE_U16 || v->type == VALUE_U8) {
+		uint64_t u = value_as<uint64_t>(v);
+		if (!std::is_floating_point<T>::value && u > (uint64_t)limits::max())
+			return 0;
+		*out = (T)u;
+	}
+	else {
+		int64_t i = value_as<int64_t>(v);
+		if (!std::is_floating_point<T>::value &&
+			(std::is_unsigned<T>::value ? i < 0 || (uint64_t)i > (uint64_t)limits::max()
+				: i < (int64_t)limits::lowest() || i > (int64_t)limits::max()))
+			return 0;
+		*out = (T)i;
+	}
+	return 1;
+}
+
+/* Clamps the number in v into T, rounding integers up or down. Returns
+ * -1 or 1 when v lies entirely below or above what T can hold. */
+template <typename T>
+static int
+value_clamp(const struct value *v, int up, T *out)
+{
+	typedef std::numeric_limits<T> limits;
+	if (std::is_floating_point<T>::value || v->type == VALUE_F32 || v->type == VALUE_F64) {
+		double d = value_as<double>(v);
+		if (std::is_floating_point<T>::value) {
+			if (d > (double)limits::max())
+				return 1;
+			if (d < (double)limits::lowest())
+				return -1;
+			*out = (T)d;
+			return 0;
+		}
+		d = up ? ceil(d) : floor(d);
+		const double limit = ldexp(1.0, limits::digits); // one past max
+		if (d >= limit)
+			return 1;
+		if (d < (std::is_signed<T>::value ? -limit : 0.0))
+			return -1;
+		*out = (T)d;
+	}
+	else if (v->type == VALUE_U64 || v->type == VALUE_U32 || v->type == VALUE_U16 || v->type == VALUE_U8) {
+		uint64_t u = value_as<uint64_t>(v);
+		if (u > (uint64_t)limits::max())
+			return 1;
+		*out = (T)u;
+	}
+	else {
+		int64_t i = value_as<int64_t>(v);
+		if (std::is_unsigned<T>::value ? i < 0 : i < (int64_t)limits::lowest())
+			return -1;
+		if (i > 0 && (uint64_t)i > (uint64_t)limits::max())
+			return 1;
+		*out = (T)i;
+	}
+	return 0;
+}
+
+/* Inclusive bounds of the range operators. Between keeps the operands as
+ * typed, near and within are worked out in double. */
+struct scan_range {
+	struct value lo;
+	struct value hi;
+};
+
+static void
+scan_range_init(struct scan_range *r, enum scan_op op, const struct value *a, const struct value *b)
+{
+	switch (op) {
+	case SCAN_OP_BETWEEN: {
+		r->lo = *a;
+		r->hi = *b;
+	} return;
+	case SCAN_OP_NEAR:
+	case SCAN_OP_WITHIN: {
+		double x = value_as<double>(a);
+		double d = fabs(value_as<double>(b));
+		if (op == SCAN_OP_WITHIN)
+			d = fabs(x) * d / 100.0;
+		r->lo.type = VALUE_F64;
+		r->lo.value.f64 = x - d;
+		r->hi.type = VALUE_F64;
+		r->hi.value.f64 = x + d;
+	} return;
+	default:
+		abort();
+	}
+}
+
+/* The range in T, or 0 when no T falls inside it. */
+template <typename T>
+static int
+scan_range_bounds(const struct scan_range *r, T *lo, T *hi)
+{
+	int below = value_clamp(&r->lo, 1, lo);
+	int above = value_clamp(&r->hi, 0, hi);
+	if (below > 0 || above < 0)
+		return 0;
+	if (below < 0)
+		*lo = std::numeric_limits<T>::lowest();
+	if (above > 0)
+		*hi = std::numeric_limits<T>::max();
+	return !(*hi < *lo);
+}
+
+/* lo <= x <= hi as a single unsigned compare for integers. */
+template <typename T>
+static void
+range_kernel(T lo, T hi, const T *cur, size_t n, unsigned char *keep, std::true_type)
+{
+	typedef typename std::make_unsigned<T>::type U;
+	const U width = (U)((U)hi - (U)lo);
+	for (size_t i = 0; i < n; i++)
+		keep[i] = (U)((U)cur[i] - (U)lo) <= width;
+}
+
+template <typename T>
+static void
+range_kernel(T lo, T hi, const T *cur, size_t n, unsigned char *keep, std::false_type)
+{
+	for (size_t i = 0; i < n; i++)
+		keep[i] = (cur[i] >= lo) & (cur[i] <= hi);
+}
+
+/* keep[i] = op(cur[i], prev[i], target) over contiguous arrays. Each
+ * case is a flat branchless loop so the compiler can vectorize it. */
+template <typename T>
+static void
+narrow_kernel(enum scan_op op, int have_target, T target, T lo, T hi,
+	const T *prev, const T *cur, size_t n, unsigned char *keep)
+{
+	typedef std::integral_constant<bool, std::is_integral<T>::value> is_int;
+	switch (op) {
+	case SCAN_OP_EQ:
+		for (size_t i = 0; i < n; i++)
+			keep[i] = cur[i] == target;
+		break;
+	case SCAN_OP_LT:
+		for (size_t i = 0; i < n; i++)
+			keep[i] = cur[i] < target;
+		break;
 	case SCAN_OP_GT:
-		pass = cmp > 0;
+		for (size_t i = 0; i < n; i++)
+			keep[i] = cur[i] > target;
 		break;
 	case SCAN_OP_LTEG:
-		pass = cmp <= 0;
+		for (size_t i = 0; i < n; i++)
+			keep[i] = cur[i] <= target;
 		break;
 	case SCAN_OP_GTEQ:
-		pass = cmp >= 0;
+		for (size_t i = 0; i < n; i++)
+			keep[i] = cur[i] >= target;
+		break;
+	case SCAN_OP_BETWEEN:
+	case SCAN_OP_NEAR:
+	case SCAN_OP_WITHIN:
+		range_kernel(lo, hi, cur, n, keep, is_int());
 		break;
+	case SCAN_OP_CHANGED:
+		for (size_t i = 0; i < n; i++)
+			keep[i] = cur[i] != prev[i];
+		break;
+	case SCAN_OP_UNCHANGED:
+		for (size_t i = 0; i < n; i++)
+			keep[i] = cur[i] == prev[i];
+		break;
+	case SCAN_OP_INCREASED:
+		if (have_target)
+			for (size_t i = 0; i < n; i++)
+				keep[i] = value_delta(cur[i], prev[i], is_int()) == target;
+		else
+			for (size_t i = 0; i < n; i++)
+				keep[i] = cur[i] > prev[i];
+		break;
+	case SCAN_OP_DECREASED:
+		if (have_target)
+			for (size_t i = 0; i < n; i++)
+				keep[i] = value_delta(prev[i], cur[i], is_int()) == target;
+		else
+			for (size_t i = 0; i < n; i++)
+				keep[i] = cur[i] < prev[i];
+		break;
+	}
+}
+
+/* Pushes every aligned T in buf that passes op, testing a chunk at a time
+ * with the narrow kernel so the comparisons vectorize. */
+#define SCAN_CHUNK 4096
+
+template <typename T>
+static void
+scan_kernel(struct watchlist *wl, uintptr_t base, uint32_t offset, const char *buf, size_t size,
+	enum value_type type, enum scan_op op, T target, T lo, T hi)
+{
+	unsigned char keep[SCAN_CHUNK];
+	const T *values = (const T *)buf;
+	const size_t count = size / sizeof(T);
+	for (size_t at = 0; at < count; at += SCAN_CHUNK) {
+		const size_t n = std::min<size_t>(SCAN_CHUNK, count - at);
+		narrow_kernel<T>(op, 1, target, lo, hi, NULL, values + at, n, keep);
+		memset(keep + n, 0, -n & 7);
+		for (size_t i = 0; i < n; i++) {
+			uint64_t word;
+			memcpy(&word, keep + (i & ~(size_t)7), sizeof(word));
+			if (!word) {
+				i |= 7; // hits are rare, skip eight misses at once
+				continue;
+			}
+			if (keep[i]) {
+				struct value read;
+				value_read(&read, type, values + at + i);
+				watchlist_push(wl, base, offset + (uint32_t)((at + i) * sizeof(T)), &read);
+			}
+		}
+	}
+}
+
+template <typename T>
+static void
+scan_region(struct watchlist *wl, uintptr_t base, const char *buf, size_t size,
+	const struct value *v, enum scan_op op, const struct scan_range *range)
+{
+	T lo = T(), hi = T();
+	if (range && !scan_range_bounds(range, &lo, &hi))
+		return;
+	scan_kernel<T>(wl, base, 0, buf, size, v->type, op, value_as<T>(v), lo, hi);
+}
+
+/* range is required by the range operators and ignored otherwise. */
+static int
+scan(struct region_map *map, struct watchlist *wl, const struct value *v, enum scan_op op, const struct scan_range *range)
+{
+	watchlist_clear(wl);
+	struct region_prefetcher it[1];
+	region_prefetcher_init(it, map, 0);
+	for (; !region_prefetcher_done(it); region_prefetcher_next(it)) {
+		const char *buf;
+		if ((buf = (const char*)region_prefetcher_memory(it))) {
+			const uintptr_t base = it->actualBase;
+			switch (v->type) {
+			case VALUE_S8:
+				scan_region<int8_t>(wl, base, buf, it->size, v, op, range);
+				break;
+			case VALUE_U8:
+				scan_region<uint8_t>(wl, base, buf, it->size, v, op, range);
+				break;
+			case VALUE_S16:
+				scan_region<int16_t>(wl, base, buf, it->size, v, op, range);
+				break;
+			case VALUE_U16:
+				scan_region<uint16_t>(wl, base, buf, it->size, v, op, range);
+				break;
+			case VALUE_S32:
+				scan_region<int32_t>(wl, base, buf, it->size, v, op, range);
+				break;
+			case VALUE_U32:
+				scan_region<uint32_t>(wl, base, buf, it->size, v, op, range);
+				break;
+			case VALUE_S64:
+				scan_region<int64_t>(wl, base, buf, it->size, v, op, range);
+				break;
+			case VALUE_U64:
+				scan_region<uint64_t>(wl, base, buf, it->size, v, op, range);
+				break;
+			case VALUE_F32:
+				scan_region<float>(wl, base, buf, it->size, v, op, range);
+				break;
+			case VALUE_F64:
+				scan_region<double>(wl, base, buf, it->size, v, op, range);
+				break;
+			}
+		}
+		else {
+			LOG_DEBUG("memory read failed [0x%016" PRIxPTR "]: %s\n",
+				it->base, os_last_error());
+		}
+	}
+	region_prefetcher_destroy(it);
+	return 1;
+}
+
+/* Operands of one type in an all-types scan. Floats compared for
+ * equality become a near range of epsilon. */
+struct scan_all_type {
+	int active;
+	enum scan_op op;
+	struct value target;
+	struct value lo;
+	struct value hi;
+};
+
+template <typename T>
+static int
+scan_all_prepare(const struct value *v, enum scan_op op, const struct scan_range *range, double epsilon,
+	enum scan_op *typeop, T *target, T *lo, T *hi)
+{
+	*typeop = op;
+	*target = *lo = *hi = T();
+	if (SCAN_OP_IS_RANGE(op))
+		return scan_range_bounds(range, lo, hi);
+	if (std::is_floating_point<T>::value && op == SCAN_OP_EQ) {
+		struct value eps;
+		eps.type = VALUE_F64;
+		eps.value.f64 = epsilon;
+		struct scan_range near;
+		scan_range_init(&near, SCAN_OP_NEAR, v, &eps);
+		*typeop = SCAN_OP_NEAR;
+		return scan_range_bounds(&near, lo, hi);
+	}
+	return value_fits(v, target);
+}
+
+/* Keeps a value held by both the signed and unsigned type of a width from
+ * being recorded twice. Of ==, < and <= the signed hits include the
+ * unsigned ones, of > and >= the unsigned hits include the signed ones.
+ * A range starting at 0 or above is the unsigned one's alone; one starting
+ * below 0 leaves the unsigned type only what's past the signed maximum. */
+template <typename S, typename U>
+static void
+scan_all_pick_signedness(enum scan_op op, int *s_active, int *u_active, S s_lo, U *u_lo, U u_hi)
+{
+	typedef std::numeric_limits<S> limits;
+	if (!*s_active || !*u_active)
+		return;
+	if (SCAN_OP_IS_RANGE(op)) {
+		if (s_lo >= 0)
+			*s_active = 0;
+		else if (u_hi > (U)limits::max())
+			*u_lo = (U)limits::max() + 1;
+		else
+			*u_active = 0;
+	}
+	else if (op == SCAN_OP_GT || op == SCAN_OP_GTEQ)
+		*s_active = 0;
+	else
+		*u_active = 0;
+}
+
+/* Like scan, but tests every value type that can hold v in the same pass
+ * over each region; hits are tagged with the type they matched as, and a
+ * value matching both signednesses of a width is recorded only once.
+ * Regions are walked in chunks small enough to stay in cache while all
+ * types look at them. */
+#define SCAN_ALL_CHUNK (16 * 1024)
+#define SCAN_ALL_EPSILON 0.001
+
+#define SCAN_ALL_PREPARE(t, field)                                          \
+    types[t].active = scan_all_prepare(v, op, range, epsilon, &types[t].op, \
+        &types[t].target.value.field, &types[t].lo.value.field,            \
+        &types[t].hi.value.field)
+
+#define SCAN_ALL_PICK_SIGNEDNESS(s, u, sfield, ufield)                      \
+    scan_all_pick_signedness(op, &types[s].active, &types[u].active,       \
+        types[s].lo.value.sfield, &types[u].lo.value.ufield,               \
+        types[u].hi.value.ufield)
+
+#define SCAN_ALL_KERNEL(t, field)                                           \
+    do {                                                                    \
+        if (types[t].active)                                                \
+            scan_kernel(wl, base, (uint32_t)at, chunk, n, t, types[t].op,   \
+                types[t].target.value.field, types[t].lo.value.field,       \
+                types[t].hi.value.field);                                   \
+    } while (0)
+
+static int
+scan_all(struct region_map *map, struct watchlist *wl, const struct value *v, enum scan_op op,
+	const struct scan_range *range, double epsilon)
+{
+	struct scan_all_type types[VALUE_TYPE_COUNT];
+	SCAN_ALL_PREPARE(VALUE_S8, s8);
+	SCAN_ALL_PREPARE(VALUE_U8, u8);
+	SCAN_ALL_PREPARE(VALUE_S16, s16);
+	SCAN_ALL_PREPARE(VALUE_U16, u16);
+	SCAN_ALL_PREPARE(VALUE_S32, s32);
+	SCAN_ALL_PREPARE(VALUE_U32, u32);
+	SCAN_ALL_PREPARE(VALUE_S64, s64);
+	SCAN_ALL_PREPARE(VALUE_U64, u64);
+	SCAN_ALL_PREPARE(VALUE_F32, f32);
+	SCAN_ALL_PREPARE(VALUE_F64, f64);
+	SCAN_ALL_PICK_SIGNEDNESS(VALUE_S8, VALUE_U8, s8, u8);
+	SCAN_ALL_PICK_SIGNEDNESS(VALUE_S16, VALUE_U16, s16, u16);
+	SCAN_ALL_PICK_SIGNEDNESS(VALUE_S32, VALUE_U32, s32, u32);
+	SCAN_ALL_PICK_SIGNEDNESS(VALUE_S64, VALUE_U64, s64, u64);
+
+	watchlist_clear(wl);
+	struct region_prefetcher it[1];
+	region_prefetcher_init(it, map, 0);
+	for (; !region_prefetcher_done(it); region_prefetcher_next(it)) {
+		const char *buf = (const char *)region_prefetcher_memory(it);
+		if (!buf) {
+			LOG_DEBUG("memory read failed [0x%016" PRIxPTR "]: %s\n",
+				it->base, os_last_error());
+			continue;
+		}
+		for (size_t at = 0; at < it->size; at += SCAN_ALL_CHUNK) {
+			const size_t n = std::min<size_t>(SCAN_ALL_CHUNK, it->size - at);
+			const char *chunk = buf + at;
+			const uintptr_t base = it->actualBase;
+			SCAN_ALL_KERNEL(VALUE_S8, s8);
+			SCAN_ALL_KERNEL(VALUE_U8, u8);
+			SCAN_ALL_KERNEL(VALUE_S16, s16);
+			SCAN_ALL_KERNEL(VALUE_U16, u16);
+			SCAN_ALL_KERNEL(VALUE_S32, s32);
+			SCAN_ALL_KERNEL(VALUE_U32, u32);
+			SCAN_ALL_KERNEL(VALUE_S64, s64);
+			SCAN_ALL_KERNEL(VALUE_U64, u64);
+			SCAN_ALL_KERNEL(VALUE_F32, f32);
+			SCAN_ALL_KERNEL(VALUE_F64, f64);
+		}
+	}
+	region_prefetcher_destroy(it);
+	return 1;
+}
+
+/* Narrows one block in place: gathers the current values next to the
+ * stored ones, runs the kernel, then compacts the survivors, whose stored
+ * value becomes the current one. Entries past the readable part of the
+ * span are dropped. */
+template <typename T>
+static void
+narrow_block(struct watchlist_block *b, enum scan_op op, const struct value *target,
+	const struct scan_range *range, const char *span, size_t actual, T *cur, unsigned char *keep)
+{
+	T lo = T(), hi = T();
+	const int empty = range && !scan_range_bounds(range, &lo, &hi);
+	const uint32_t first = b->offsets[0];
+	size_t n = 0;
+	for (; !empty && n < b->count && b->offsets[n] - first + sizeof(T) <= actual; n++)
+		memcpy(&cur[n], span + (b->offsets[n] - first), sizeof(T));
+
+	T *prev = (T *)b->values;
+	narrow_kernel<T>(op, target != NULL, target ? value_as<T>(target) : T(), lo, hi,
+		prev, cur, n, keep);
+
+	size_t kept = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (keep[i]) {
+			b->offsets[kept] = b->offsets[i];
+			prev[kept] = cur[i];
+			kept++;
+		}
+	}
+	b->count = kept;
+}
+
+/* target may be NULL for the relative operators, range is required by
+ * the range operators. */
+static int
+narrow(struct watchlist *wl, enum scan_op op, const struct value *target, const struct scan_range *range)
+{
+	char *span = NULL;
+	size_t spansize = 0;
+	void *cur = NULL;
+	unsigned char *keep = NULL;
+	size_t capacity = 0;
+
+	struct watchlist_block **link = &wl->head;
+	wl->tail = NULL;
+	wl->count = 0;
+	while (*link) {
+		struct watchlist_block *b = *link;
+		if (b->count) {
+			const unsigned size = VALUE_TYPE_SIZE(b->type);
+			const size_t need = b->offsets[b->count - 1] - b->offsets[0] + size;
+			if (spansize < need) {
+				free(span);
+				spansize = need;
+				span = (char *)malloc(spansize);
+			}
+			if (capacity < b->count) {
+				free(cur);
+				free(keep);
+				capacity = b->capacity;
+				cur = malloc(capacity * sizeof(uint64_t));
+				keep = (unsigned char *)malloc(capacity);
+			}
+			if (!span || !cur || !keep)
+				FATAL("out of memory while narrowing\n");
+			const size_t actual = os_read_memory(wl->process, b->base + b->offsets[0], span, need);
+
+			switch (b->type) {
+			case VALUE_S8:
+				narrow_block(b, op, target, range, span, actual, (int8_t *)cur, keep);
+				break;
+			case VALUE_U8:
+				narrow_block(b, op, target, range, span, actual, (uint8_t *)cur, keep);
+				break;
+			case VALUE_S16:
+				narrow_block(b, op, target, range, span, actual, (int16_t *)cur, keep);
+				break;
+			case VALUE_U16:
+				narrow_block(b, op, target, range, span, actual, (uint16_t *)cur, keep);
+				break;
+			case VALUE_S32:
+				narrow_block(b, op, target, range, span, actual, (int32_t *)cur, keep);
+				break;
+			case VALUE_U32:
+				narrow_block(b, op, target, range, span, actual, (uint32_t *)cur, keep);
+				break;
+			case VALUE_S64:
+				narrow_block(b, op, target, range, span, actual, (int64_t *)cur, keep);
+				break;
+			case VALUE_U64:
+				narrow_block(b, op, target, range, span, actual, (uint64_t *)cur, keep);
+				break;
+			case VALUE_F32:
+				narrow_block(b, op, target, range, span, actual, (float *)cur, keep);
+				break;
+			case VALUE_F64:
+				narrow_block(b, op, target, range, span, actual, (double *)cur, keep);
+				break;
+			}
+		}
+
+		if (!b->count) {
+			*link = b->next;
+			free(b);
+		}
+		else {
+			wl->count += b->count;
+			wl->tail = b;
+			link = &b->next;
+		}
 	}
-	if (pass)
-		watchlist_push(s->wl, addr, v);
+	std::memset(wl->open, 0, sizeof(wl->open)); // pushes start fresh blocks
+
+	free(span);
+	free(cur);
+	free(keep);
+	return 1;
+}
+
+/* Signature scanning */
+
+/* A byte pattern with a per-byte mask (mask 0 = wildcard). Every pattern
+ * is keyed on one fully specified "anchor" byte; a single pass over memory
+ * looks for all anchor bytes at once (SSE2 compare when there are only a
+ * few distinct ones, a 256-entry bucket table otherwise) and only verifies
+ * the patterns keyed on the byte that was hit, so adding patterns barely
+ * changes the cost of the pass. */
+#define SIGNATURE_MAX 64
+#define SIGNATURE_SIMD_NEEDLES 8
+
+struct signature {
+	size_t len;
+	size_t anchor;
+	unsigned char bytes[SIGNATURE_MAX]; // pre-masked
+	unsigned char mask[SIGNATURE_MAX];
+};
+
+struct signature_hit {
+	size_t signature;
+	uintptr_t addr;
+};
+
+static int
+signature_hexdigit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
 }
 
+/* Picks the anchor byte: the first fully specified byte that isn't 00 or
+ * ff, since those fill most of a process. */
 static int
-narrow(struct watchlist *wl, enum scan_op op, struct value *v)
-{
-	struct watchlist out[1];
-	watchlist_init(out, wl->process);
-	struct narrow_visitor_state state;
-	state.wl = out;
-	state.target = *v;
-	state.op = op;
-
-	watchlist_visit(wl, narrow_visitor, &state);
-	watchlist_free(wl);
-	*wl = *out;
+signature_finish(struct signature *sig)
+{
+	int anchor = -1;
+	for (size_t i = 0; i < sig->len; i++) {
+		if (sig->mask[i] != 0xff)
+			continue;
+		if (anchor < 0)
+			anchor = (int)i;
+		if (sig->bytes[i] != 0x00 && sig->bytes[i] != 0xff) {
+			anchor = (int)i;
+			break;
+		}
+	}
+	if (anchor < 0)
+		return 0;
+	sig->anchor = anchor;
 	return 1;
 }
 
+/* Hex bytes separated by spaces; '?' is a wildcard nibble ("??", "4?").
+ * A double-quoted token is taken literally: "43 ?? \"Cross\"". */
+static int
+signature_parse(struct signature *sig, const char *pattern)
+{
+	std::memset(sig, 0, sizeof(*sig));
+	for (const char *p = pattern; *p;) {
+		if (*p == ' ') {
+			p++;
+		}
+		else if (*p == '"') {
+			for (p++; *p && *p != '"'; p++) {
+				if (sig->len == SIGNATURE_MAX)
+					return 0;
+				sig->bytes[sig->len] = (unsigned char)*p;
+				sig->mask[sig->len++] = 0xff;
+			}
+			if (*p++ != '"')
+				return 0;
+		}
+		else {
+			if (sig->len == SIGNATURE_MAX || !p[1])
+				return 0;
+			unsigned char byte = 0;
+			unsigned char mask = 0;
+			for (int n = 0; n < 2; n++, p++) {
+				byte <<= 4;
+				mask <<= 4;
+				if (*p == '?')
+					continue;
+				int d = signature_hexdigit(*p);
+				if (d < 0)
+					return 0;
+				byte |= d;
+				mask |= 0xf;
+			}
+			sig->bytes[sig->len] = byte;
+			sig->mask[sig->len++] = mask;
+		}
+	}
+	return signature_finish(sig);
+}
+
+struct signature_index {
+	const struct signature *sigs;
+	size_t count;
+	std::vector<size_t> buckets[256]; // signatures keyed on each anchor byte
+	unsigned char needles[256];
+	size_t nneedles;
+	std::vector<int> found;
+	size_t nfound;
+	std::vector<struct signature_hit> *hits;
+};
+
+static void
+signature_index_init(struct signature_index *ix, const struct signature *sigs, size_t count,
+	std::vector<struct signature_hit> *hits)
+{
+	ix->sigs = sigs;
+	ix->count = count;
+	ix->nneedles = 0;
+	for (size_t i = 0; i < count; i++) {
+		const unsigned char c = sigs[i].bytes[sigs[i].anchor];
+		if (ix->buckets[c].empty())
+			ix->needles[ix->nneedles++] = c;
+		ix->buckets[c].push_back(i);
+	}
+	ix->found.assign(count, 0);
+	ix->nfound = 0;
+	ix->hits = hits;
+}
+
+static int
+signature_index_done(const struct signature_index *ix)
+{
+	return ix->nfound == ix->count;
+}
+
+/* Verifies the signatures keyed on buf[pos]. */
+static void
+signature_check(struct signature_index *ix, const unsigned char *buf, size_t size,
+	size_t pos, uintptr_t base)
+{
+	for (size_t n : ix->buckets[buf[pos]]) {
+		const struct signature *sig = &ix->sigs[n];
+		if (pos < sig->anchor || pos - sig->anchor + sig->len > size)
+			continue;
+		if (ix->found[n])
+			continue;
+		const unsigned char *start = buf + pos - sig->anchor;
+		size_t i = 0;
+		while (i < sig->len && (start[i] & sig->mask[i]) == sig->bytes[i])
+			i++;
+		if (i == sig->len) {
+			struct signature_hit hit;
+			hit.signature = n;
+			hit.addr = base + (pos - sig->anchor);
+			ix->hits->push_back(hit);
+			ix->found[n] = 1;
+			ix->nfound++;
+		}
+	}
+}
+
+static void
+signature_scan_buffer(struct signature_index *ix, const unsigned char *buf, size_t size, uintptr_t base)
+{
+	size_t pos = 0;
+	if (ix->nneedles <= SIGNATURE_SIMD_NEEDLES) {
+		__m128i needles[SIGNATURE_SIMD_NEEDLES];
+		for (size_t i = 0; i < ix->nneedles; i++)
+			needles[i] = _mm_set1_epi8((char)ix->needles[i]);
+		for (; pos + 16 <= size && !signature_index_done(ix); pos += 16) {
+			const __m128i v = _mm_loadu_si128((const __m128i *)(buf + pos));
+			__m128i eq = _mm_setzero_si128();
+			for (size_t i = 0; i < ix->nneedles; i++)
+				eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, needles[i]));
+			unsigned long bits = (unsigned long)_mm_movemask_epi8(eq);
+			while (bits) {
+				unsigned long bit;
+				_BitScanForward(&bit, bits);
+				signature_check(ix, buf, size, pos + bit, base);
+				bits &= bits - 1;
+			}
+		}
+	}
+	for (; pos < size && !signature_index_done(ix); pos++)
+		if (!ix->buckets[buf[pos]].empty())
+			signature_check(ix, buf, size, pos, base);
+}
+
+/* One pass over all readable regions not matching skip and starting below
+ * end, giving the lowest address of each signature. The pass ends as soon
+ * as every signature has a hit. */
+static void
+signature_scan(struct region_map *map, const struct signature *sigs, size_t count,
+	unsigned long skip, uintptr_t end, std::vector<struct signature_hit> *hits)
+{
+	struct signature_index ix[1];
+	signature_index_init(ix, sigs, count, hits);
+	if (!count)
+		return;
+
+	struct region_prefetcher it[1];
+	region_prefetcher_init(it, map, skip);
+	for (; !region_prefetcher_done(it) && !signature_index_done(ix) && it->actualBase < end; region_prefetcher_next(it)) {
+		const unsigned char *buf = (const unsigned char *)region_prefetcher_memory(it);
+		if (buf)
+			signature_scan_buffer(ix, buf, it->size, it->actualBase);
+	}
+	region_prefetcher_destroy(it);
+}
+
 static void
 display_memory_regions(os_handle target)
 {
@@ -880,17 +2226,137 @@ enum command {
 	COMMAND_ATTACH = 0,
 	COMMAND_MEMORY,
 	COMMAND_FIND,
+	COMMAND_FINDANY,
 	COMMAND_NARROW,
 	COMMAND_PUSH,
 	COMMAND_LIST,
+	COMMAND_SAVE,
+	COMMAND_LOAD,
 	COMMAND_SET,
 	COMMAND_LOCK,
+	COMMAND_UNLOCK,
+	COMMAND_PERIOD,
+	COMMAND_STATS,
 	COMMAND_WAIT,
 	COMMAND_HELP,
 	COMMAND_QUIT,
 };
 
 
+/* Locked values flattened into runs of adjacent bytes that never cross
+ * a page, each run being a single WriteProcessMemory. Values are copied
+ * in, so the plan stays valid while the watchlist changes under it. */
+#define LOCK_PERIOD_DEFAULT 0.1
+#define LOCK_PERIOD_MIN     0.001
+
+struct lock_run {
+	uintptr_t addr;
+	size_t size;
+	size_t offset; // into lock_plan bytes
+};
+
+struct lock_plan {
+	struct lock_run *runs;
+	size_t count;
+	unsigned char *bytes;
+};
+
+struct lock_entry {
+	uintptr_t addr;
+	unsigned size;
+	const unsigned char *value;
+};
+
+static void
+lock_plan_free(struct lock_plan *plan)
+{
+	free(plan->runs);
+	free(plan->bytes);
+	plan->runs = NULL;
+	plan->bytes = NULL;
+	plan->count = 0;
+}
+
+static void
+lock_plan_build(struct lock_plan *plan, const struct watchlist *wl)
+{
+	lock_plan_free(plan);
+	std::vector<struct lock_entry> entries;
+	entries.reserve(wl->count);
+	size_t nbytes = 0;
+	for (struct watchlist_block *b = wl->head; b; b = b->next) {
+		unsigned size = VALUE_TYPE_SIZE(b->type);
+		for (size_t i = 0; i < b->count; i++) {
+			struct lock_entry e = {watchlist_addr(b, i), size, b->values + i * size};
+			entries.push_back(e);
+			nbytes += size;
+		}
+	}
+	if (entries.empty())
+		return;
+
+	/* Stable so that of two locks on the same bytes the later one wins. */
+	std::stable_sort(entries.begin(), entries.end(),
+		[](const struct lock_entry &a, const struct lock_entry &b) {
+			return a.addr < b.addr;
+		});
+
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	const uintptr_t page = info.dwPageSize;
+
+	plan->runs = (lock_run *)malloc(entries.size() * sizeof(plan->runs[0]));
+	plan->bytes = (unsigned char *)malloc(nbytes);
+	if (!plan->runs || !plan->bytes) {
+		lock_plan_free(plan);
+		return;
+	}
+	size_t used = 0;
+	struct lock_run *run = NULL;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const struct lock_entry *e = &entries[i];
+		const uintptr_t run_end = run ? run->addr + run->size : 0;
+		const int joins = run && e->addr <= run_end &&
+			(e->addr + e->size - 1) / page == run->addr / page;
+		if (!joins) {
+			run = &plan->runs[plan->count++];
+			run->addr = e->addr;
+			run->size = 0;
+			run->offset = used;
+		}
+		const size_t at = e->addr - run->addr;
+		if (at + e->size > run->size) {
+			used += at + e->size - run->size;
+			run->size = at + e->size;
+		}
+		memcpy(plan->bytes + run->offset + at, e->value, e->size);
+	}
+}
+
+struct locker_stats {
+	uint64_t cycles;
+	uint64_t writes;   // WriteProcessMemory calls
+	uint64_t failures;
+	double cost_min, cost_max, cost_total;
+	double jitter_min, jitter_max, jitter_total; // lateness of each cycle
+};
+
+static void
+locker_stats_add(struct locker_stats *s, double cost, double jitter)
+{
+	if (!s->cycles || cost < s->cost_min)
+		s->cost_min = cost;
+	if (!s->cycles || jitter < s->jitter_min)
+		s->jitter_min = jitter;
+	if (cost > s->cost_max)
+		s->cost_max = cost;
+	if (jitter > s->jitter_max)
+		s->jitter_max = jitter;
+	s->cost_total += cost;
+	s->jitter_total += jitter;
+	s->cycles++;
+}
+
 struct memdig {
 	os_pid id;
 	os_handle target;
@@ -898,28 +2364,67 @@ struct memdig {
 	enum value_type last_type;
 	struct watchlist active;
 	struct watchlist locked;
+	struct region_map regions;
 	int running;
+	int lock_dirty;     // locked changed, wake the locker after setting
+	double lock_period; // seconds between rewrites
+	struct locker_stats lock_stats;
+	uintptr_t (*anchor)(void); // saved watchlists are relative to this, absolute if NULL
 };
 
+/* Sleeps on a condition variable until the next cycle is due or the
+ * locked set changes, then rewrites everything with one write per run.
+ * A fine system timer is only requested while the period needs it. */
 static void
 memdig_locker(struct memdig *m)
 {
-	for (;;) {
-		os_sleep(0.1);
-		os_mutex_lock(&m->thread);
-		if (!m->running) {
-			os_mutex_unlock(&m->thread);
-			break;
+	struct lock_plan plan[1] = {{0}};
+	double deadline = 0;
+	UINT timer_resolution = 0;
+	os_mutex_lock(&m->thread);
+	while (m->running) {
+		if (m->lock_dirty) {
+			lock_plan_build(plan, &m->locked);
+			m->lock_dirty = 0;
+			deadline = os_time(); // apply new locks right away
 		}
-		if (m->target)
-			for (size_t i = 0; i < m->locked.count; i++) {
-				uintptr_t addr = m->locked.list[i].addr;
-				struct value *value = &m->locked.list[i].prev;
-				unsigned size = VALUE_SIZE(*value);
-				os_write_memory(m->target, addr, &value->value, size);
-			}
-		os_mutex_unlock(&m->thread);
+
+		UINT want = plan->count && m->lock_period < 0.015 ? 1 : 0;
+		if (want != timer_resolution) {
+			if (timer_resolution)
+				timeEndPeriod(timer_resolution);
+			if (want)
+				timeBeginPeriod(want);
+			timer_resolution = want;
+		}
+
+		if (!plan->count || !m->target) {
+			os_mutex_wait(&m->thread, -1);
+			continue;
+		}
+		double now = os_time();
+		if (now < deadline) {
+			os_mutex_wait(&m->thread, deadline - now);
+			continue;
+		}
+
+		for (size_t i = 0; i < plan->count; i++) {
+			struct lock_run *r = &plan->runs[i];
+			if (!os_write_memory(m->target, r->addr, plan->bytes + r->offset, r->size))
+				m->lock_stats.failures++;
+		}
+		m->lock_stats.writes += plan->count;
+		double done = os_time();
+		locker_stats_add(&m->lock_stats, done - now, now - deadline);
+
+		deadline += m->lock_period;
+		if (deadline <= done)
+			deadline = done + m->lock_period; // fell behind, don't burst to catch up
 	}
+	if (timer_resolution)
+		timeEndPeriod(timer_resolution);
+	lock_plan_free(plan);
+	os_mutex_unlock(&m->thread);
 }
 
 static void
@@ -927,12 +2432,13 @@ memdig_init(struct memdig *m)
 {
 	std::memset(m, 0, sizeof(*m));
 	m->last_type = VALUE_S32;
+	m->lock_period = LOCK_PERIOD_DEFAULT;
 	m->running = 1;
 	os_thread_start(&m->thread, m);
 }
 
 static void
-list_visitor(uintptr_t addr, const struct value *v, void *file)
+list_visitor(uintptr_t base, uint32_t offset, const struct value *v, void *file)
 {
 	char buf[64] = "???";
 	if (v)
@@ -946,13 +2452,69 @@ enum memdig_result {
 	MEMDIG_RESULT_QUIT = 1,
 };
 
+/* Parses a command argument as a value, reporting why it is not one. */
+static int
+command_value(struct value *v, const char *arg)
+{
+	switch (value_parse(v, arg)) {
+	case VALUE_PARSE_OVERFLOW:
+		LOG_ERROR("overflow '%s'\n", arg);
+	case VALUE_PARSE_INVALID:
+		LOG_ERROR("invalid value '%s'\n", arg);
+	case VALUE_PARSE_SUCCESS:
+		break;
+	}
+	return 1;
+fail:
+	return 0;
+}
+
+static const struct {
+	char name[8];
+	enum command command;
+	const char *help;
+} command_table[] = {
+	{"attach", COMMAND_ATTACH, "[pid|pattern]  select a process"},
+	{"memory", COMMAND_MEMORY, "               list memory regions"},
+	{"find", COMMAND_FIND, "[op] value [b] scan memory as the type of value"},
+	{"findany", COMMAND_FINDANY, "[op] value [e] scan memory as every type holding value"},
+	{"narrow", COMMAND_NARROW, "[op] [a] [b]   narrow the watchlist"},
+	{"push", COMMAND_PUSH, "0xaddr         add an address to the watchlist"},
+	{"list", COMMAND_LIST, "[a|p|l]        list watchlist, processes or locks"},
+	{"save", COMMAND_SAVE, "file           save the watchlist relative to the anchor"},
+	{"load", COMMAND_LOAD, "file           replace the watchlist with a saved one"},
+	{"set", COMMAND_SET, "value          write value to every watchlist address"},
+	{"lock", COMMAND_LOCK, "[value]        keep rewriting the watchlist values"},
+	{"unlock", COMMAND_UNLOCK, "               stop rewriting all locked values"},
+	{"period", COMMAND_PERIOD, "[seconds]      show or set the time between rewrites"},
+	{"stats", COMMAND_STATS, "[reset]        cost and timing of the rewrites"},
+	{"wait", COMMAND_WAIT, "seconds        sleep"},
+	{"help", COMMAND_HELP, "               this list"},
+	{"quit", COMMAND_QUIT, "               stop reading commands"},
+};
+
+/* An exact verb or an unambiguous prefix of one. */
+static enum command
+command_parse(const char *verb)
+{
+	enum command command = COMMAND_UNKNOWN;
+	const size_t length = strlen(verb);
+	for (unsigned i = 0; i < sizeof(command_table) / sizeof(command_table[0]); i++) {
+		if (strcmp(command_table[i].name, verb) == 0)
+			return command_table[i].command;
+		if (length && strncmp(command_table[i].name, verb, length) == 0)
+			command = command == COMMAND_UNKNOWN ? command_table[i].command : COMMAND_AMBIGUOUS;
+	}
+	return command;
+}
+
 static enum memdig_result
 memdig_exec(struct memdig *m, int argc, char **argv)
 {
 	if (argc == 0)
 		return MEMDIG_RESULT_OK;
 	char *verb = argv[0];
-	enum command command = COMMAND_AMBIGUOUS; //no parse needed so just removed compile errors
+	enum command command = command_parse(verb);
 	switch (command) {
 	case COMMAND_AMBIGUOUS: {
 		LOG_ERROR("ambiguous command '%s'\n", verb);
@@ -974,8 +2536,11 @@ memdig_exec(struct memdig *m, int argc, char **argv)
 			os_mutex_lock(&m->thread);
 			watchlist_free(&m->active);
 			watchlist_free(&m->locked);
+			region_map_destroy(&m->regions);
 			os_process_close(m->target);
 			m->target = 0;
+			m->lock_dirty = 1;
+			os_thread_wake(&m->thread);
 			os_mutex_unlock(&m->thread);
 		}
 		char *pattern = argv[1];
@@ -997,6 +2562,7 @@ memdig_exec(struct memdig *m, int argc, char **argv)
 			else {
 				watchlist_init(&m->active, m->target);
 				watchlist_init(&m->locked, m->target);
+				region_map_init(&m->regions, m->target, REGION_MAP_MAX_AGE);
 				printf("attached to %ld\n", (long)m->id);
 			}
 			os_mutex_unlock(&m->thread);
@@ -1008,68 +2574,120 @@ memdig_exec(struct memdig *m, int argc, char **argv)
 			LOG_ERROR("no process attached\n");
 		display_memory_regions(m->target);
 	} break;
-	case COMMAND_FIND: {
+	case COMMAND_FIND: {
+		/* find [op] value, or find between|near|within a b */
+		if (!m->target)
+			LOG_ERROR("no process attached\n");
+		if (argc < 2 || argc > 4)
+			LOG_ERROR("wrong number of arguments\n");
+		enum scan_op op = SCAN_OP_EQ;
+		if (argc > 2 && !scan_op_parse(argv[1], &op))
+			LOG_ERROR("invalid operator '%s'\n", argv[1]);
+		if (SCAN_OP_IS_RELATIVE(op))
+			LOG_ERROR("'%s' needs a previous scan, use narrow\n", argv[1]);
+		if (SCAN_OP_IS_RANGE(op) != (argc == 4))
+			LOG_ERROR("wrong number of arguments\n");
+		struct value value;
+		struct scan_range range;
+		if (!command_value(&value, argv[argc == 2 ? 1 : 2]))
+			goto fail;
+		if (SCAN_OP_IS_RANGE(op)) {
+			struct value second;
+			if (!command_value(&second, argv[3]))
+				goto fail;
+			scan_range_init(&range, op, &value, &second);
+			LOG_INFO("finding %s %s %s\n", argv[1], argv[2], argv[3]);
+		}
+		else {
+			char buf[64];
+			value_print(buf, sizeof(buf), &value);
+			LOG_INFO("finding %s\n", buf);
+		}
+		m->last_type = value.type;
+		if (!scan(&m->regions, &m->active, &value, op, SCAN_OP_IS_RANGE(op) ? &range : NULL))
+			LOG_ERROR("scan failure'\n");
+		else
+			printf("%zu values found\n", m->active.count);
+	} break;
+	case COMMAND_FINDANY: {
+		/* findany [op] value [epsilon], or findany between|near|within a b */
 		if (!m->target)
 			LOG_ERROR("no process attached\n");
-		if (argc < 2 || argc > 3)
+		if (argc < 2 || argc > 4)
 			LOG_ERROR("wrong number of arguments\n");
 		enum scan_op op = SCAN_OP_EQ;
-		const char *arg = argv[1];
-		if (argc == 3) {
-			if (!scan_op_parse(argv[1], &op))
-				LOG_ERROR("invalid operator '%s'\n", argv[1]);
-			arg = argv[2];
-		}
+		int argi = 1;
+		if (argc > 2 && scan_op_parse(argv[1], &op))
+			argi++;
+		if (SCAN_OP_IS_RELATIVE(op))
+			LOG_ERROR("'%s' needs a previous scan, use narrow\n", argv[1]);
+		if (argi >= argc)
+			LOG_ERROR("missing value\n");
 		struct value value;
-		enum value_parse_result r = value_parse(&value, arg);
-		switch (r) {
-		case VALUE_PARSE_OVERFLOW: {
-			LOG_ERROR("overflow '%s'\n", arg);
-		} break;
-		case VALUE_PARSE_INVALID: {
-			LOG_ERROR("invalid value '%s'\n", arg);
-		} break;
-		case VALUE_PARSE_SUCCESS: {
-			char buf[64];
-			value_print(buf, sizeof(buf), &value);
-			LOG_INFO("finding %s\n", buf);
-		} break;
+		struct scan_range range;
+		double epsilon = SCAN_ALL_EPSILON;
+		if (!command_value(&value, argv[argi++]))
+			goto fail;
+		if (SCAN_OP_IS_RANGE(op)) {
+			struct value second;
+			if (argi + 1 != argc)
+				LOG_ERROR("wrong number of arguments\n");
+			if (!command_value(&second, argv[argi++]))
+				goto fail;
+			scan_range_init(&range, op, &value, &second);
 		}
-		m->last_type = value.type;
-		if (!scan(&m->active, &value, op))
+		else if (argi < argc) {
+			epsilon = atof(argv[argi++]);
+		}
+		if (argi != argc)
+			LOG_ERROR("wrong number of arguments\n");
+		LOG_INFO("finding %s as any type\n", argv[argc - 1]);
+		if (!scan_all(&m->regions, &m->active, &value, op, SCAN_OP_IS_RANGE(op) ? &range : NULL, epsilon))
 			LOG_ERROR("scan failure'\n");
 		else
 			printf("%zu values found\n", m->active.count);
 	} break;
 	case COMMAND_NARROW: {
+		/* narrow [op] value, narrow changed|unchanged|increased|decreased,
+		 * or narrow between|near|within a b */
 		if (!m->target)
 			LOG_ERROR("no process attached\n");
-		if (argc < 2 || argc > 3)
+		if (argc < 2 || argc > 4)
 			LOG_ERROR("wrong number of arguments\n");
 		enum scan_op op = SCAN_OP_EQ;
 		const char *arg = argv[1];
-		if (argc == 3) {
+		if (argc > 2) {
 			if (!scan_op_parse(argv[1], &op))
 				LOG_ERROR("invalid operator '%s'\n", argv[1]);
 			arg = argv[2];
 		}
+		else if (scan_op_parse(argv[1], &op)) {
+			if (!SCAN_OP_IS_RELATIVE(op))
+				LOG_ERROR("operator '%s' needs a value\n", argv[1]);
+			arg = NULL;
+		}
+		if (SCAN_OP_IS_RANGE(op) != (argc == 4))
+			LOG_ERROR("wrong number of arguments\n");
 		struct value value;
-		enum value_parse_result r = value_parse(&value, arg);
-		switch (r) {
-		case VALUE_PARSE_OVERFLOW: {
-			LOG_ERROR("overflow '%s'\n", arg);
-		} break;
-		case VALUE_PARSE_INVALID: {
-			LOG_ERROR("invalid value '%s'\n", arg);
-		} break;
-		case VALUE_PARSE_SUCCESS: {
-			char buf[64];
-			value_print(buf, sizeof(buf), &value);
-			LOG_INFO("narrowing to %s\n", buf);
-		} break;
+		struct scan_range range;
+		if (arg) {
+			if (!command_value(&value, arg))
+				goto fail;
+			if (SCAN_OP_IS_RANGE(op)) {
+				struct value second;
+				if (!command_value(&second, argv[3]))
+					goto fail;
+				scan_range_init(&range, op, &value, &second);
+				LOG_INFO("narrowing to %s %s %s\n", argv[1], argv[2], argv[3]);
+			}
+			else {
+				char buf[64];
+				value_print(buf, sizeof(buf), &value);
+				LOG_INFO("narrowing to %s\n", buf);
+			}
 		}
 
-		if (!narrow(&m->active, op, &value))
+		if (!narrow(&m->active, op, arg ? &value : NULL, SCAN_OP_IS_RANGE(op) ? &range : NULL))
 			LOG_ERROR("scan failure'\n");
 		else
 			printf("%zu values found\n", m->active.count);
@@ -1086,7 +2704,7 @@ memdig_exec(struct memdig *m, int argc, char **argv)
 		struct value value;
 		value.type = m->last_type;
 		value.value.u64 = 0;
-		watchlist_push(&m->active, addr, &value);
+		watchlist_push(&m->active, addr, 0, &value);
 	} break;
 	case COMMAND_LIST: {
 		char arg = 'a';
@@ -1138,15 +2756,16 @@ memdig_exec(struct memdig *m, int argc, char **argv)
 		}
 		m->last_type = value.type;
 		size_t set_count = 0;
-		for (size_t i = 0; i < m->active.count; i++) {
-			uintptr_t addr = m->active.list[i].addr;
-			unsigned size = VALUE_SIZE(value);
-			if (!os_write_memory(m->target, addr, &value.value, size))
-				LOG_WARNING("write memory failed: %s\n",
-					os_last_error());
-			else
-				set_count++;
-		}
+		for (struct watchlist_block *b = m->active.head; b; b = b->next)
+			for (size_t i = 0; i < b->count; i++) {
+				uintptr_t addr = watchlist_addr(b, i);
+				unsigned size = VALUE_SIZE(value);
+				if (!os_write_memory(m->target, addr, &value.value, size))
+					LOG_WARNING("write memory failed: %s\n",
+						os_last_error());
+				else
+					set_count++;
+			}
 		printf("%zu values set\n", set_count);
 	} break;
 	case COMMAND_LOCK: {
@@ -1175,103 +2794,617 @@ memdig_exec(struct memdig *m, int argc, char **argv)
 			}
 			m->last_type = value.type;
 		}
-		os_mutex_lock(&m->thread);
-		for (size_t i = 0; i < m->active.count; i++) {
-			uintptr_t addr = m->active.list[i].addr;
-			struct value *prev = &m->active.list[i].prev;
-			watchlist_push(&m->locked, addr, have_value ? &value : prev);
+		os_mutex_lock(&m->thread);
+		for (struct watchlist_block *b = m->active.head; b; b = b->next)
+			for (size_t i = 0; i < b->count; i++) {
+				struct value prev;
+				watchlist_value(b, i, &prev);
+				watchlist_push(&m->locked, b->base, b->offsets[i], have_value ? &value : &prev);
+			}
+		m->lock_dirty = 1;
+		os_thread_wake(&m->thread);
+		os_mutex_unlock(&m->thread);
+	} break;
+	case COMMAND_UNLOCK: {
+		if (!m->target)
+			LOG_ERROR("no process attached\n");
+		os_mutex_lock(&m->thread);
+		printf("%zu values unlocked\n", m->locked.count);
+		watchlist_clear(&m->locked);
+		m->lock_dirty = 1;
+		os_thread_wake(&m->thread);
+		os_mutex_unlock(&m->thread);
+	} break;
+	case COMMAND_SAVE:
+	case COMMAND_LOAD: {
+		if (argc != 2)
+			LOG_ERROR("wrong number of arguments\n");
+		uintptr_t anchor = 0;
+		if (m->anchor && !(anchor = m->anchor()))
+			LOG_ERROR("anchor not found, cannot place the watchlist\n");
+		if (command == COMMAND_SAVE) {
+			if (!watchlist_save(&m->active, argv[1], anchor))
+				LOG_ERROR("could not save to '%s'\n", argv[1]);
+			printf("%zu values saved\n", m->active.count);
+		}
+		else {
+			if (!m->target)
+				LOG_ERROR("no process attached\n");
+			if (!watchlist_load(&m->active, &m->regions, argv[1], anchor))
+				LOG_ERROR("could not load '%s'\n", argv[1]);
+			printf("%zu values loaded\n", m->active.count);
+		}
+	} break;
+	case COMMAND_PERIOD: {
+		if (argc == 1) {
+			printf("locking every %g s\n", m->lock_period);
+			return MEMDIG_RESULT_OK;
+		}
+		if (argc != 2)
+			LOG_ERROR("wrong number of arguments");
+		double period = atof(argv[1]);
+		if (!(period >= LOCK_PERIOD_MIN))
+			LOG_ERROR("period must be at least %g s\n", LOCK_PERIOD_MIN);
+		os_mutex_lock(&m->thread);
+		m->lock_period = period;
+		os_thread_wake(&m->thread);
+		os_mutex_unlock(&m->thread);
+	} break;
+	case COMMAND_STATS: {
+		os_mutex_lock(&m->thread);
+		struct locker_stats s = m->lock_stats;
+		if (argc == 2 && strcmp(argv[1], "reset") == 0)
+			std::memset(&m->lock_stats, 0, sizeof(m->lock_stats));
+		os_mutex_unlock(&m->thread);
+		if (!s.cycles) {
+			printf("no lock cycles yet\n");
+			return MEMDIG_RESULT_OK;
+		}
+		printf("%" PRIu64 " cycles, %.1f writes per cycle, %" PRIu64 " failed\n",
+			s.cycles, (double)s.writes / s.cycles, s.failures);
+		printf("cost   min %.1f avg %.1f max %.1f us\n",
+			s.cost_min * 1e6, s.cost_total / s.cycles * 1e6, s.cost_max * 1e6);
+		printf("jitter min %.1f avg %.1f max %.1f us\n",
+			s.jitter_min * 1e6, s.jitter_total / s.cycles * 1e6, s.jitter_max * 1e6);
+	} break;
+	case COMMAND_WAIT: {
+		if (argc != 2)
+			LOG_ERROR("wrong number of arguments");
+		os_sleep(atof(argv[1]));
+	} break;
+	case COMMAND_HELP: {
+		for (unsigned i = 0; i < sizeof(command_table) / sizeof(command_table[0]); i++)
+			printf("  %-8s%s\n", command_table[i].name, command_table[i].help);
+		printf("Operators of find, findany and narrow: = < > <= >=, and the inclusive ranges between a b,\n"
+			"near value distance and within value percent. Narrow also takes changed, unchanged,\n"
+			"and increased or decreased, optionally by an amount.\n");
+		printf("Commands may be abbreviated. Integers are 32 bits unless suffixed o (8), h (16) or q (64),\n"
+			"u makes them unsigned, e.g. 200uo; 1.5 is a double and 1.5f a float.\n");
+	} break;
+	case COMMAND_QUIT: {
+		return MEMDIG_RESULT_QUIT;
+	} break;
+	}
+	return MEMDIG_RESULT_OK;
+fail:
+	return MEMDIG_RESULT_ERROR;
+}
+
+static void
+memdig_free(struct memdig *m)
+{
+	os_mutex_lock(&m->thread);
+	if (m->target) {
+		watchlist_free(&m->active);
+		watchlist_free(&m->locked);
+		region_map_destroy(&m->regions);
+		os_process_close(m->target);
+		m->target = 0;
+	}
+	m->running = 0;
+	os_thread_wake(&m->thread);
+	os_mutex_unlock(&m->thread);
+	os_thread_join(&m->thread);
+}
+
+#define PROMPT(f)                               \
+    do {                                        \
+        fputs("> ", f);                         \
+        fflush(f);                              \
+    } while(0)
+
+/*int
+main(int argc, char **argv)
+{
+	int result = 0;
+	struct memdig memdig[1];
+	memdig_init(memdig);
+
+	char *xargv[16];
+	int xargc = 0;
+	int i = 1;
+	while (i < argc && argv[i][0] == '-') {
+		xargc = 1;
+		xargv[0] = argv[i++];
+		while (xargv[0][0] == '-' && xargv[0][0] != 0)
+			xargv[0]++;
+		while (i < argc && argv[i][0] != '-' && xargc < 15)
+			xargv[xargc++] = argv[i++];
+		xargv[xargc] = NULL;
+		enum memdig_result r = memdig_exec(memdig, xargc, xargv);
+		if (r == MEMDIG_RESULT_ERROR)
+			result = -1;
+		if (r != MEMDIG_RESULT_OK)
+			goto quit;
+		if (strcmp(xargv[0], "help") == 0)
+			goto quit;
+		if (strcmp(xargv[0], "version") == 0)
+			goto quit;
+	}
+
+	char line[4096];
+	PROMPT(stdout);
+	const char *delim = " \n\t";
+	while (fgets(line, sizeof(line), stdin)) {
+		xargc = 0;
+		xargv[0] = strtok(line, delim);
+		if (xargv[0]) {
+			do
+				xargc++;
+			while (xargc < 15 && (xargv[xargc] = strtok(NULL, delim)));
+			xargv[xargc] = NULL;
+		}
+		if (memdig_exec(memdig, xargc, xargv) == MEMDIG_RESULT_QUIT)
+			goto quit;
+		PROMPT(stdout);
+	}
+
+quit:
+	memdig_free(memdig);
+	return result;
+}*/
+
+static memdig _instance;
+static bool _instanceInited;
+static std::string _processFilename;
+static std::mutex _commandMutex; //a scanner command runs to completion before the instance is torn down
+
+struct AnchorDefinition
+{
+	const char* Name;
+	const char* Pattern; //signature_parse syntax
+};
+
+//in-process structures located by content, all unresolved ones are looked up in the same pass
+static const AnchorDefinition _anchorDefinitions[] =
+{
+	{ "Title", "\"Close Combat: Cross of Iron\"" }, //shared offset of memory dumps
+};
+constexpr std::size_t NumAnchors = sizeof(_anchorDefinitions) / sizeof(_anchorDefinitions[0]);
+
+//resolved addresses are kept for the attach session and persisted per CC3.exe build
+static const char* const AnchorCacheFilename = "HiddenDragonAnchors.txt";
+static uint64_t _executableHash;
+static signature _anchorSignatures[NumAnchors];
+static uint32_t _anchorAddresses[NumAnchors]; //0 if not resolved
+static bool _anchorFromCache[NumAnchors]; //loaded from an earlier launch and not checked yet
+static uintptr_t _imageBase; //CC3.exe module, which is mapped at the same address every launch
+static uintptr_t _imageEnd;
+static std::recursive_mutex _anchorMutex; //anchors and pointer paths are also resolved from the live game state thread
+
+static uint64_t HashFile(const std::string& filename)
+{
+	//FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	std::ifstream is(filename, std::ios::binary);
+	char buffer[65536];
+	while (is.read(buffer, sizeof(buffer)) || is.gcount() > 0)
+	{
+		for (std::streamsize i = 0; i < is.gcount(); ++i)
+		{
+			hash ^= static_cast<uint8_t>(buffer[i]);
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+static void LoadAnchorCache()
+{
+	std::ifstream is(AnchorCacheFilename);
+	uint64_t hash;
+	std::string name;
+	uint32_t address;
+	while (is >> std::hex >> hash >> name >> std::dec >> address)
+	{
+		if (hash != _executableHash)
+			continue;
+
+		for (std::size_t i = 0; i < NumAnchors; ++i)
+		{
+			if (name == _anchorDefinitions[i].Name)
+			{
+				_anchorAddresses[i] = address; //revalidated on first use
+				_anchorFromCache[i] = true;
+			}
+		}
+	}
+}
+
+static void SaveAnchorCache()
+{
+	//keep what other builds of the game resolved to
+	std::vector<std::string> otherBuilds;
+	{
+		std::ifstream is(AnchorCacheFilename);
+		std::string line;
+		while (std::getline(is, line))
+		{
+			uint64_t hash;
+			if (std::istringstream(line) >> std::hex >> hash && hash != _executableHash)
+				otherBuilds.push_back(line);
+		}
+	}
+
+	std::ofstream os(AnchorCacheFilename);
+	for (const std::string& line : otherBuilds)
+		os << line << std::endl;
+	for (std::size_t i = 0; i < NumAnchors; ++i)
+	{
+		if (_anchorAddresses[i] != 0)
+			os << std::hex << _executableHash << std::dec << ' ' << _anchorDefinitions[i].Name << ' ' << _anchorAddresses[i] << std::endl;
+	}
+}
+
+static std::size_t FindAnchor(const std::string& name)
+{
+	for (std::size_t i = 0; i < NumAnchors; ++i)
+	{
+		if (name == _anchorDefinitions[i].Name)
+			return i;
+	}
+	return NumAnchors;
+}
+
+static bool AnchorMatchesAt(std::size_t anchor, uint32_t address)
+{
+	const signature& sig = _anchorSignatures[anchor];
+	unsigned char buffer[SIGNATURE_MAX];
+	if (region_map_read(&_instance.regions, address, buffer, sig.len) != sig.len)
+		return false;
+
+	for (std::size_t i = 0; i < sig.len; ++i)
+	{
+		if ((buffer[i] & sig.mask[i]) != sig.bytes[i])
+			return false;
+	}
+	return true;
+}
+
+//an address from an earlier launch is only kept if a fresh scan would give it too, the shared offset of dumps must not
+//move between launches: it has to be inside the CC3.exe image, which doesn't move, and no copy may come before it
+//the check scans only what lies below it, normally little more than the start of the image
+static bool CheckCachedAnchor(std::size_t anchor)
+{
+	_anchorFromCache[anchor] = false;
+	const uint32_t address = _anchorAddresses[anchor];
+	if (address < _imageBase || address >= _imageEnd || !AnchorMatchesAt(anchor, address))
+		return false;
+
+	std::vector<signature_hit> hits;
+	signature_scan(&_instance.regions, &_anchorSignatures[anchor], 1, REGION_ITERATOR_EXECUTE, address, &hits);
+	return hits.empty() || hits[0].addr >= address;
+}
+
+static bool AnchorHolds(std::size_t anchor)
+{
+	if (_anchorAddresses[anchor] == 0)
+		return false;
+	return _anchorFromCache[anchor] ? CheckCachedAnchor(anchor) : AnchorMatchesAt(anchor, _anchorAddresses[anchor]);
+}
+
+//a cached anchor costs one small read to revalidate, anything stale is rescanned together in one pass
+static uint32_t ResolveAnchor(std::size_t anchor)
+{
+	std::lock_guard<std::recursive_mutex> lock(_anchorMutex);
+	if (AnchorHolds(anchor))
+		return _anchorAddresses[anchor];
+
+	std::vector<std::size_t> missing;
+	std::vector<signature> missingSignatures;
+	for (std::size_t i = 0; i < NumAnchors; ++i)
+	{
+		if (_anchorAddresses[i] != 0 && (i == anchor || !AnchorHolds(i)))
+			_anchorAddresses[i] = 0;
+		if (_anchorAddresses[i] == 0)
+		{
+			missing.push_back(i);
+			missingSignatures.push_back(_anchorSignatures[i]);
+		}
+	}
+
+	std::vector<signature_hit> hits;
+	signature_scan(&_instance.regions, missingSignatures.data(), missingSignatures.size(), REGION_ITERATOR_EXECUTE, UINTPTR_MAX, &hits); //not interested in program code
+	for (const signature_hit& hit : hits)
+	{
+		uint32_t& address = _anchorAddresses[missing[hit.signature]];
+		if (address == 0)
+			address = static_cast<uint32_t>(hit.addr);
+	}
+
+	for (std::size_t i : missing)
+	{
+		if (_anchorAddresses[i] == 0)
+			std::cerr << "Unable to find anchor " << _anchorDefinitions[i].Name << std::endl;
+	}
+
+	SaveAnchorCache();
+	return _anchorAddresses[anchor];
+}
+
+uint32_t GetAnchorAddress(const std::string& name)
+{
+	const std::size_t anchor = FindAnchor(name);
+	if (anchor != NumAnchors)
+		return ResolveAnchor(anchor);
+
+	std::cerr << "Unknown anchor " << name << std::endl;
+	return 0;
+}
+
+void ReadMemoryBatch(std::vector<MemoryRead>& reads)
+{
+	std::vector<read_request> requests(reads.size());
+	for (std::size_t i = 0; i < reads.size(); ++i)
+	{
+		requests[i].addr = reads[i].Address;
+		requests[i].buf = reads[i].Buffer;
+		requests[i].size = reads[i].Size;
+	}
+
+	if (_instance.target)
+		region_map_read_batch(&_instance.regions, requests.data(), requests.size());
+
+	for (std::size_t i = 0; i < reads.size(); ++i)
+		reads[i].Ok = _instance.target && requests[i].actual == reads[i].Size;
+}
+
+//the cached resolution of every path, and every anchor the paths start from, is checked in one batched read
+static void ValidatePointerPaths(const std::vector<PointerPath*>& paths, bool anchorValid[NumAnchors])
+{
+	std::vector<read_request> requests;
+	std::vector<std::vector<unsigned char>> anchorBytes(NumAnchors);
+	std::vector<std::size_t> anchorRequest(NumAnchors, SIZE_MAX);
+	for (PointerPath* path : paths)
+	{
+		const std::size_t anchor = FindAnchor(path->Anchor);
+		if (anchor == NumAnchors || _anchorAddresses[anchor] == 0 || anchorRequest[anchor] != SIZE_MAX)
+			continue;
+
+		anchorBytes[anchor].resize(_anchorSignatures[anchor].len);
+		anchorRequest[anchor] = requests.size();
+		requests.push_back({ _anchorAddresses[anchor], anchorBytes[anchor].data(), anchorBytes[anchor].size(), 0 });
+	}
+
+	std::vector<uint32_t> guardValues;
+	for (PointerPath* path : paths)
+	{
+		if (path->Address != 0)
+			guardValues.resize(guardValues.size() + path->Guards.size());
+	}
+	std::size_t guardIndex = 0;
+	for (PointerPath* path : paths)
+	{
+		if (path->Address == 0)
+			continue;
+		for (const auto& guard : path->Guards)
+			requests.push_back({ guard.first, &guardValues[guardIndex++], sizeof(uint32_t), 0 });
+	}
+
+	region_map_read_batch(&_instance.regions, requests.data(), requests.size());
+
+	for (std::size_t i = 0; i < NumAnchors; ++i)
+	{
+		anchorValid[i] = false;
+		if (anchorRequest[i] == SIZE_MAX || requests[anchorRequest[i]].actual != anchorBytes[i].size())
+			continue;
+
+		const signature& sig = _anchorSignatures[i];
+		anchorValid[i] = true;
+		for (std::size_t j = 0; j < sig.len; ++j)
+		{
+			if ((anchorBytes[i][j] & sig.mask[j]) != sig.bytes[j])
+				anchorValid[i] = false;
+		}
+	}
+
+	guardIndex = 0;
+	std::size_t requestIndex = requests.size() - guardValues.size();
+	for (PointerPath* path : paths)
+	{
+		if (path->Address == 0)
+			continue;
+
+		const std::size_t anchor = FindAnchor(path->Anchor);
+		bool valid = anchor != NumAnchors && anchorValid[anchor] && path->Base == _anchorAddresses[anchor];
+		for (const auto& guard : path->Guards)
+		{
+			if (requests[requestIndex++].actual != sizeof(uint32_t) || guardValues[guardIndex++] != guard.second)
+				valid = false;
 		}
-		os_mutex_unlock(&m->thread);
-	} break;
-	case COMMAND_WAIT: {
-		if (argc != 2)
-			LOG_ERROR("wrong number of arguments");
-		os_sleep(atof(argv[1]));
-	} break;
-	case COMMAND_QUIT: {
-		return MEMDIG_RESULT_QUIT;
-	} break;
+		if (!valid)
+			path->Address = 0;
 	}
-	return MEMDIG_RESULT_OK;
-fail:
-	return MEMDIG_RESULT_ERROR;
 }
 
-static void
-memdig_free(struct memdig *m)
+bool ResolvePointerPaths(const std::vector<PointerPath*>& paths)
 {
-	os_mutex_lock(&m->thread);
-	if (m->target) {
-		watchlist_free(&m->active);
-		watchlist_free(&m->locked);
-		os_process_close(m->target);
-		m->target = 0;
+	if (!_instance.target)
+		return false;
+
+	std::lock_guard<std::recursive_mutex> lock(_anchorMutex);
+	bool anchorValid[NumAnchors];
+	ValidatePointerPaths(paths, anchorValid);
+
+	//stale paths are walked one level at a time, each level in one batched read
+	std::vector<PointerPath*> pending;
+	for (PointerPath* path : paths)
+	{
+		if (path->Address != 0)
+			continue;
+
+		const std::size_t anchor = FindAnchor(path->Anchor);
+		if (anchor == NumAnchors)
+		{
+			std::cerr << "Unknown anchor " << path->Anchor << std::endl;
+			continue;
+		}
+		if (!anchorValid[anchor])
+		{
+			ResolveAnchor(anchor); //rescans every stale anchor at once
+			anchorValid[anchor] = true;
+		}
+
+		path->Base = _anchorAddresses[anchor];
+		path->Guards.clear();
+		if (path->Base == 0)
+			continue;
+
+		path->Address = path->Base + (path->Offsets.empty() ? 0 : path->Offsets[0]);
+		pending.push_back(path);
 	}
-	m->running = 0;
-	os_mutex_unlock(&m->thread);
-	os_thread_join(&m->thread);
+
+	for (std::size_t level = 1; !pending.empty(); ++level)
+	{
+		std::vector<PointerPath*> next;
+		std::vector<read_request> requests;
+		std::vector<uint32_t> pointers;
+		for (PointerPath* path : pending)
+		{
+			if (level < path->Offsets.size())
+				next.push_back(path);
+		}
+		pointers.resize(next.size());
+		for (std::size_t i = 0; i < next.size(); ++i)
+			requests.push_back({ next[i]->Address, &pointers[i], sizeof(uint32_t), 0 });
+
+		region_map_read_batch(&_instance.regions, requests.data(), requests.size());
+
+		pending.clear();
+		for (std::size_t i = 0; i < next.size(); ++i)
+		{
+			PointerPath* path = next[i];
+			if (requests[i].actual != sizeof(uint32_t) || pointers[i] == 0)
+			{
+				path->Address = 0;
+				continue;
+			}
+
+			path->Guards.emplace_back(path->Address, pointers[i]);
+			path->Address = pointers[i] + path->Offsets[level];
+			pending.push_back(path);
+		}
+	}
+
+	bool allResolved = true;
+	for (PointerPath* path : paths)
+	{
+		if (path->Address == 0)
+			allResolved = false;
+	}
+	return allResolved;
 }
 
-#define PROMPT(f)                               \
-    do {                                        \
-        fputs("> ", f);                         \
-        fflush(f);                              \
-    } while(0)
+bool ResolvePointerPath(PointerPath& path)
+{
+	return ResolvePointerPaths({ &path });
+}
 
-/*int
-main(int argc, char **argv)
+std::vector<PointerPath> FindPointerPaths(uint32_t address, uint32_t maxOffset, int maxDepth, std::size_t maxResults)
 {
-	int result = 0;
-	struct memdig memdig[1];
-	memdig_init(memdig);
+	std::vector<PointerPath> paths;
+	const uint32_t title = GetAnchorAddress("Title");
+	if (title == 0)
+		return paths;
+
+	//one copy of all data memory, the index only lives for this call
+	std::vector<std::vector<uint8_t>> buffers;
+	std::vector<PointerScanRegion> regions;
+	region_prefetcher it[1];
+	region_prefetcher_init(it, &_instance.regions, REGION_ITERATOR_EXECUTE); //not interested in program code
+	for (; !region_prefetcher_done(it); region_prefetcher_next(it))
+	{
+		const uint8_t* buf = (const uint8_t*)region_prefetcher_memory(it);
+		if (!buf)
+			continue;
 
-	char *xargv[16];
-	int xargc = 0;
-	int i = 1;
-	while (i < argc && argv[i][0] == '-') {
-		xargc = 1;
-		xargv[0] = argv[i++];
-		while (xargv[0][0] == '-' && xargv[0][0] != 0)
-			xargv[0]++;
-		while (i < argc && argv[i][0] != '-' && xargc < 15)
-			xargv[xargc++] = argv[i++];
-		xargv[xargc] = NULL;
-		enum memdig_result r = memdig_exec(memdig, xargc, xargv);
-		if (r == MEMDIG_RESULT_ERROR)
-			result = -1;
-		if (r != MEMDIG_RESULT_OK)
-			goto quit;
-		if (strcmp(xargv[0], "help") == 0)
-			goto quit;
-		if (strcmp(xargv[0], "version") == 0)
-			goto quit;
+		buffers.emplace_back(buf, buf + it->size);
+		regions.push_back({ static_cast<uint32_t>(it->actualBase), nullptr, it->size });
+	}
+	region_prefetcher_destroy(it);
+	for (std::size_t i = 0; i < regions.size(); ++i)
+		regions[i].Data = buffers[i].data();
+
+	PointerIndex index;
+	index.Build(regions);
+
+	//roots in the same allocation as the anchor are the ones likely to survive a restart, list those first
+	//its committed ranges are copied out so the search doesn't hold up the region map
+	std::vector<std::pair<uintptr_t, uintptr_t>> anchorAllocation;
+	EnterCriticalSection(&_instance.regions.lock);
+	const region_map_entry* anchorRegion = region_map_find(&_instance.regions, title);
+	for (std::size_t i = 0; anchorRegion && i < _instance.regions.count; ++i)
+	{
+		const region_map_entry& entry = _instance.regions.entries[i];
+		if (entry.base == anchorRegion->base)
+			anchorAllocation.emplace_back(entry.actualBase, entry.actualBase + entry.size);
 	}
+	LeaveCriticalSection(&_instance.regions.lock);
 
-	char line[4096];
-	PROMPT(stdout);
-	const char *delim = " \n\t";
-	while (fgets(line, sizeof(line), stdin)) {
-		xargc = 0;
-		xargv[0] = strtok(line, delim);
-		if (xargv[0]) {
-			do
-				xargc++;
-			while (xargc < 15 && (xargv[xargc] = strtok(NULL, delim)));
-			xargv[xargc] = NULL;
-		}
-		if (memdig_exec(memdig, xargc, xargv) == MEMDIG_RESULT_QUIT)
-			goto quit;
-		PROMPT(stdout);
+	const std::vector<PointerChain> chains = index.FindChains(address, maxOffset, maxDepth, maxResults, [&](uint32_t root)
+	{
+		return std::any_of(anchorAllocation.cbegin(), anchorAllocation.cend(), [&](const std::pair<uintptr_t, uintptr_t>& range)
+		{
+			return root >= range.first && root < range.second;
+		});
+	});
+
+	for (const PointerChain& chain : chains)
+	{
+		PointerPath path;
+		path.Anchor = "Title";
+		path.Offsets.push_back(static_cast<int32_t>(chain.Root - title));
+		path.Offsets.insert(path.Offsets.end(), chain.Offsets.begin(), chain.Offsets.end());
+		paths.push_back(std::move(path));
 	}
+	return paths;
+}
 
-quit:
-	memdig_free(memdig);
-	return result;
-}*/
+static void InitAnchors()
+{
+	for (std::size_t i = 0; i < NumAnchors; ++i)
+	{
+		const bool valid = signature_parse(&_anchorSignatures[i], _anchorDefinitions[i].Pattern);
+		assert(valid);
+		_anchorAddresses[i] = 0;
+		_anchorFromCache[i] = false;
+	}
+
+	//the first module listed is the executable
+	HMODULE image;
+	DWORD needed;
+	MODULEINFO info;
+	_imageBase = _imageEnd = 0;
+	if (EnumProcessModules(_instance.target, &image, sizeof(image), &needed) && GetModuleInformation(_instance.target, image, &info, sizeof(info)))
+	{
+		_imageBase = reinterpret_cast<uintptr_t>(info.lpBaseOfDll);
+		_imageEnd = _imageBase + info.SizeOfImage;
+	}
+
+	_executableHash = HashFile(_processFilename);
+	LoadAnchorCache();
+}
 
-static memdig _instance;
-static bool _instanceInited;
-static std::string _processFilename;
 bool AttachToCloseCombat()
 {
 	if (_instanceInited)
@@ -1287,7 +3420,9 @@ bool AttachToCloseCombat()
 
 	_instanceInited = true;
 	_instance.last_type = VALUE_S32;
+	_instance.lock_period = LOCK_PERIOD_DEFAULT;
 	_instance.running = 1;
+	_instance.anchor = []() -> uintptr_t { return GetAnchorAddress("Title"); };
 	os_thread_start(&_instance.thread, &_instance);
 	os_mutex_lock(&_instance.thread);
 
@@ -1302,6 +3437,8 @@ bool AttachToCloseCombat()
 	}
 	else
 	{
+		region_map_init(&_instance.regions, _instance.target, REGION_MAP_MAX_AGE);
+
 		char filename[MAX_PATH + 1];
 		const DWORD filenameLength = GetModuleFileNameExA(_instance.target, nullptr, filename, MAX_PATH + 1);
 		if (filenameLength == 0)
@@ -1312,6 +3449,7 @@ bool AttachToCloseCombat()
 		{
 			retval = true;
 			_processFilename = filename;
+			InitAnchors();
 		}
 
 		watchlist_init(&_instance.active, _instance.target);
@@ -1345,80 +3483,100 @@ void DetachFromCloseCombat()
 	if (!_instanceInited)
 		return;
 
+	StopWatching();
+	std::lock_guard<std::mutex> commandLock(_commandMutex);
 	os_mutex_lock(&_instance.thread);
 	if (_instance.target)
 	{
 		watchlist_free(&_instance.active);
 		watchlist_free(&_instance.locked);
+		region_map_destroy(&_instance.regions);
 		os_process_close(_instance.target);
 		_instance.target = 0;
 	}
 	_instance.running = 0;
+	os_thread_wake(&_instance.thread);
+	std::memset(_anchorAddresses, 0, sizeof(_anchorAddresses));
 	os_mutex_unlock(&_instance.thread);
 	os_thread_join(&_instance.thread);
 }
 
-static uint32_t FindSharedOffset(const char* magic)
+bool ExecuteMemoryCommand(const std::string& line)
 {
-	uint32_t sharedOffset = 0;
-	const std::size_t len = std::strlen(magic);
-
-	region_iterator it[1];
-	region_iterator_init(it, _instance.target);
-
-	for (; !region_iterator_done(it); region_iterator_next(it))
+	std::istringstream ss(line);
+	std::vector<std::string> words;
+	for (std::string word; ss >> word && words.size() < 15; )
+		words.push_back(word);
+	std::vector<char*> argv;
+	for (std::string& word : words)
+		argv.push_back(&word[0]);
+	argv.push_back(nullptr);
+
+	std::lock_guard<std::mutex> lock(_commandMutex);
+	if (!_instanceInited || !_instance.running)
 	{
-		if (it->flags & REGION_ITERATOR_EXECUTE)
-		{
-			continue; //not interested in program code
-		}
-
-		const char* const buf = (const char*)region_iterator_memory(it);
-		if (buf)
-		{
-			std::size_t offset = 0;
-			std::size_t remaining = it->size;
-			while (remaining >= len)
-			{
-				if (std::memcmp(buf + offset, magic, len) == 0)
-				{
-					sharedOffset = static_cast<uint32_t>(it->actualBase + offset);
-					goto End;
-				}
-
-				offset += 1;
-				remaining -= 1;
-			}
-			
-		}
+		std::cerr << "Not attached to CC3.exe\n";
+		return true;
 	}
-	End:
-	region_iterator_destroy(it);
+	if (!words.empty() && command_parse(argv[0]) == COMMAND_ATTACH)
+	{
+		std::cerr << "Attaching is up to the bot\n"; //others share the process handle and region map
+		return true;
+	}
+	return memdig_exec(&_instance, static_cast<int>(words.size()), argv.data()) != MEMDIG_RESULT_QUIT;
+}
+
+static uint32_t GetSharedOffset()
+{
+	return GetAnchorAddress("Title");
+}
 
+bool SaveWatchlist(const std::string& filename)
+{
+	const uint32_t sharedOffset = GetSharedOffset();
 	if (sharedOffset == 0)
+		return false;
+
+	if (!watchlist_save(&_instance.active, filename.c_str(), sharedOffset))
 	{
-		std::cerr << "Unable to find shared offset " << magic << std::endl;
+		std::cerr << "Failed to save watchlist to " << filename << std::endl;
+		return false;
 	}
+	return true;
+}
 
-	return sharedOffset;
+bool LoadWatchlist(const std::string& filename)
+{
+	const uint32_t sharedOffset = GetSharedOffset();
+	if (!_instance.target || sharedOffset == 0)
+		return false;
+
+	if (!watchlist_load(&_instance.active, &_instance.regions, filename.c_str(), sharedOffset))
+	{
+		std::cerr << "Failed to load watchlist from " << filename << std::endl;
+		return false;
+	}
+	return true;
 }
 
+bool ReadMemory(uint32_t address, void* buffer, std::size_t size)
+{
+	if (!_instance.target)
+		return false;
+
+	return region_map_read(&_instance.regions, address, buffer, size) == size;
+}
 
 void DumpMemory(std::ostream& binaryStream, bool segmented)
 {
-	const uint32_t sharedOffset = FindSharedOffset("Close Combat: Cross of Iron");
+	const uint32_t sharedOffset = GetSharedOffset();
 
-	region_iterator it[1];
-	region_iterator_init(it, _instance.target);
+	region_prefetcher it[1];
+	region_prefetcher_init(it, &_instance.regions, REGION_ITERATOR_EXECUTE); //not interested in program code
 
-	for (; !region_iterator_done(it); region_iterator_next(it))
+	for (; !region_prefetcher_done(it); region_prefetcher_next(it))
 	{
-		if (it->flags & REGION_ITERATOR_EXECUTE)
-		{
-			continue; //not interested in program code
-		}
-
-		const char* buf = (const char*)region_iterator_memory(it);
+		const char* buf = (const char*)region_prefetcher_memory(it);
 		if (buf)
 		{
 			if (segmented)
@@ -1436,5 +3594,295 @@ void DumpMemory(std::ostream& binaryStream, bool segmented)
 			std::cerr << "CC3.exe memory read failed: " << os_last_error() << std::endl;
 		}
 	}
-	region_iterator_destroy(it);
+	region_prefetcher_destroy(it);
+}
+
+//single producer, single consumer, neither side ever waits
+template <typename T, std::size_t Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+	bool Push(const T& item)
+	{
+		const std::size_t tail = _Tail.load(std::memory_order_relaxed);
+		if (tail - _Head.load(std::memory_order_acquire) == Capacity)
+			return false;
+		_Items[tail & (Capacity - 1)] = item;
+		_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T& item)
+	{
+		const std::size_t head = _Head.load(std::memory_order_relaxed);
+		if (head == _Tail.load(std::memory_order_acquire))
+			return false;
+		item = _Items[head & (Capacity - 1)];
+		_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+private:
+	std::atomic<std::size_t> _Head{ 0 };
+	std::atomic<std::size_t> _Tail{ 0 };
+	T _Items[Capacity];
+};
+
+static_assert(static_cast<int>(WatchType::F64) == VALUE_F64, "WatchType must match value_type");
+
+struct WatchSubscription
+{
+	int Id;
+	uint32_t Address;
+	WatchType Type;
+	std::size_t Count;
+	std::size_t Stride;
+};
+
+//subscribed values kept in a watchlist so neighbours in a committed region share a block, each block is polled
+//as one span per run of values no further than WATCH_SPAN_MAX_GAP apart
+#define WATCH_SPAN_MAX_GAP 4096
+
+struct WatchSpan
+{
+	const watchlist_block* Block;
+	std::size_t First; //values [First, First + Ids.size()) of the block
+	std::vector<int> Ids; //subscription of each value in the span
+	uintptr_t Address;
+	std::vector<uint8_t> Previous;
+	std::vector<uint8_t> Current;
+	bool Primed;
+};
+
+static std::mutex _watchMutex; //guards subscriptions
+static std::vector<WatchSubscription> _watchSubscriptions;
+static int _nextWatchId = 1;
+static bool _watchDirty;
+static std::thread _watchThread;
+static std::atomic<bool> _watching(false);
+static SpscQueue<WatchEvent, 4096> _watchEvents;
+static std::atomic<uint64_t> _droppedWatchEvents(0);
+
+int Watch(uint32_t address, WatchType type, std::size_t count, std::size_t stride)
+{
+	std::lock_guard<std::mutex> lock(_watchMutex);
+	_watchSubscriptions.push_back({ _nextWatchId, address, type, count, stride });
+	_watchDirty = true;
+	return _nextWatchId++;
+}
+
+void Unwatch(int subscription)
+{
+	std::lock_guard<std::mutex> lock(_watchMutex);
+	_watchSubscriptions.erase(std::remove_if(_watchSubscriptions.begin(), _watchSubscriptions.end(), [&](const WatchSubscription& s)
+	{
+		return s.Id == subscription;
+	}), _watchSubscriptions.end());
+	_watchDirty = true;
+}
+
+static void BuildWatchSpans(watchlist& wl, std::vector<WatchSpan>& spans)
+{
+	struct Entry
+	{
+		uintptr_t Address;
+		value_type Type;
+		int Id;
+	};
+	std::vector<Entry> entries;
+	{
+		std::lock_guard<std::mutex> lock(_watchMutex);
+		for (const WatchSubscription& s : _watchSubscriptions)
+		{
+			for (std::size_t i = 0; i < s.Count; ++i)
+				entries.push_back({ s.Address + i * s.Stride, static_cast<value_type>(s.Type), s.Id });
+		}
+		_watchDirty = false;
+	}
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+	{
+		return a.Address < b.Address;
+	});
+
+	watchlist_free(&wl);
+	std::unordered_map<const watchlist_block*, std::vector<int>> ids;
+	EnterCriticalSection(&_instance.regions.lock);
+	for (const Entry& e : entries)
+	{
+		//per committed region rather than allocation, so no span reaches into a decommitted or guard page
+		const region_map_entry* region = region_map_find(&_instance.regions, e.Address);
+		const uintptr_t base = region ? region->actualBase : e.Address;
+		value v;
+		v.type = e.Type;
+		v.value.u64 = 0;
+		watchlist_push(&wl, base, static_cast<uint32_t>(e.Address - base), &v);
+		ids[wl.open[e.Type]].push_back(e.Id);
+	}
+	LeaveCriticalSection(&_instance.regions.lock);
+
+	//spans covering the same bytes as before keep their previous values, so a rebuild doesn't lose a tick of events
+	std::map<std::pair<uintptr_t, std::size_t>, WatchSpan> old;
+	for (WatchSpan& span : spans)
+	{
+		if (span.Primed)
+			old[std::make_pair(span.Address, span.Current.size())] = std::move(span);
+	}
+
+	spans.clear();
+	for (const watchlist_block* b = wl.head; b; b = b->next)
+	{
+		const std::vector<int>& blockIds = ids[b];
+		const unsigned size = VALUE_TYPE_SIZE(b->type);
+		for (std::size_t first = 0, last; first < b->count; first = last)
+		{
+			uintptr_t end = watchlist_addr(b, first) + size;
+			for (last = first + 1; last < b->count && watchlist_addr(b, last) <= end + WATCH_SPAN_MAX_GAP; ++last)
+				end = std::max<uintptr_t>(end, watchlist_addr(b, last) + size);
+
+			WatchSpan span;
+			span.Block = b;
+			span.First = first;
+			span.Ids.assign(blockIds.begin() + first, blockIds.begin() + last);
+			span.Address = watchlist_addr(b, first);
+			span.Current.resize(end - span.Address);
+			span.Primed = false;
+			const auto it = old.find(std::make_pair(span.Address, span.Current.size()));
+			if (it != old.end())
+			{
+				span.Previous = std::move(it->second.Previous);
+				span.Primed = true;
+				old.erase(it);
+			}
+			else
+			{
+				span.Previous.resize(span.Current.size());
+			}
+			spans.push_back(std::move(span));
+		}
+	}
+}
+
+//one bit per 16 bytes that differ, compared a vector at a time
+static void MarkChangedChunks(const uint8_t* a, const uint8_t* b, std::size_t size, std::vector<uint64_t>& changed)
+{
+	changed.assign((size + 16 * 64 - 1) / (16 * 64), 0);
+	std::size_t i = 0;
+	for (; i + 16 <= size; i += 16)
+	{
+		const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff)
+			changed[i / (16 * 64)] |= 1ULL << ((i / 16) & 63);
+	}
+	if (i < size && std::memcmp(a + i, b + i, size - i) != 0)
+		changed[i / (16 * 64)] |= 1ULL << ((i / 16) & 63);
+}
+
+static void EmitWatchEvents(const WatchSpan& span, const std::vector<uint64_t>& changed, std::chrono::steady_clock::time_point now)
+{
+	const watchlist_block* b = span.Block;
+	const unsigned size = VALUE_TYPE_SIZE(b->type);
+	for (std::size_t i = 0; i < span.Ids.size(); ++i)
+	{
+		const std::size_t at = watchlist_addr(b, span.First + i) - span.Address;
+		bool touched = false;
+		for (std::size_t chunk = at / 16; chunk <= (at + size - 1) / 16 && !touched; ++chunk)
+			touched = (changed[chunk / 64] >> (chunk & 63)) & 1;
+		if (!touched || std::memcmp(&span.Previous[at], &span.Current[at], size) == 0)
+			continue;
+
+		WatchEvent event;
+		event.Subscription = span.Ids[i];
+		event.Address = static_cast<uint32_t>(span.Address + at);
+		event.Type = static_cast<WatchType>(b->type);
+		event.Old = 0;
+		event.New = 0;
+		std::memcpy(&event.Old, &span.Previous[at], size);
+		std::memcpy(&event.New, &span.Current[at], size);
+		event.Time = now;
+		if (!_watchEvents.Push(event))
+			++_droppedWatchEvents;
+	}
+}
+
+static void RunWatchThread(double rate)
+{
+	watchlist wl;
+	watchlist_init(&wl, _instance.target);
+	std::vector<WatchSpan> spans;
+	std::vector<read_request> requests;
+	std::vector<uint64_t> changed;
+
+	const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
+	auto next = std::chrono::steady_clock::now();
+	while (_watching)
+	{
+		bool dirty;
+		{
+			std::lock_guard<std::mutex> lock(_watchMutex);
+			dirty = _watchDirty;
+		}
+		if (dirty)
+			BuildWatchSpans(wl, spans);
+
+		requests.clear();
+		for (WatchSpan& span : spans)
+			requests.push_back({ span.Address, span.Current.data(), span.Current.size(), 0 });
+		region_map_read_batch(&_instance.regions, requests.data(), requests.size());
+
+		const auto now = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < spans.size(); ++i)
+		{
+			WatchSpan& span = spans[i];
+			if (requests[i].actual != span.Current.size())
+			{
+				span.Primed = false;
+				continue;
+			}
+			if (span.Primed)
+			{
+				MarkChangedChunks(span.Previous.data(), span.Current.data(), span.Current.size(), changed);
+				EmitWatchEvents(span, changed, now);
+			}
+			span.Previous.swap(span.Current);
+			span.Primed = true;
+		}
+
+		next += period;
+		if (next < now)
+			next = now;
+		std::this_thread::sleep_until(next);
+	}
+	watchlist_free(&wl);
+}
+
+void StartWatching(double rate)
+{
+	StopWatching();
+	if (!_instance.target || !(rate > 0))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(_watchMutex);
+		_watchDirty = true;
+	}
+	_watching = true;
+	_watchThread = std::thread(RunWatchThread, rate);
+}
+
+void StopWatching()
+{
+	_watching = false;
+	if (_watchThread.joinable())
+		_watchThread.join();
+}
+
+bool PopWatchEvent(WatchEvent& event)
+{
+	return _watchEvents.Pop(event);
+}
+
+uint64_t GetDroppedWatchEvents()
+{
+	return _droppedWatchEvents;
 }
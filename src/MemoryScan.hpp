@@ -5,3 +5,69 @@ const std::string& GetAttachedFilename();
 std::string GetAttachedPathPrefix();
 void DetachFromCloseCombat();
 void DumpMemory(std::ostream& binaryStream, bool segmented);
+uint32_t GetAnchorAddress(const std::string& name); //0 if not found
+//the scanner's current watchlist in a compact binary file, addresses relative to the Title anchor
+//so a list narrowed down before CC3 crashed is rebased onto the new process when loaded
+bool SaveWatchlist(const std::string& filename);
+bool LoadWatchlist(const std::string& filename);
+//one line of the value scanner's commands (find, findany, narrow, lock, ...; "help" lists them) against CC3.exe
+//the watchlist they build is the one SaveWatchlist writes, false once "quit" was given
+bool ExecuteMemoryCommand(const std::string& line);
+//reads CC3.exe memory through the cached region map; false unless all of size was read
+bool ReadMemory(uint32_t address, void* buffer, std::size_t size);
+
+struct MemoryRead
+{
+	uint32_t Address;
+	void* Buffer;
+	std::size_t Size;
+	bool Ok; //set by ReadMemoryBatch
+};
+//nearby reads in the same region are merged into one, so many small reads cost a handful of system calls
+void ReadMemoryBatch(std::vector<MemoryRead>& reads);
+
+//a location in CC3.exe memory: the named anchor plus Offsets[0], then for each further offset the
+//32-bit pointer stored at the current location is followed and the offset added to it
+struct PointerPath
+{
+	std::string Anchor;
+	std::vector<int32_t> Offsets;
+
+	//cached resolution, 0 if unresolved
+	//kept as long as the anchor is intact and every pointer followed still holds the same value
+	uint32_t Address = 0;
+	uint32_t Base = 0;
+	std::vector<std::pair<uint32_t, uint32_t>> Guards; //pointer location, value followed
+};
+//cached paths are revalidated together in one batched read, stale ones re-resolved with one batched read per level
+//false if any path could not be resolved, its Address is then 0
+bool ResolvePointerPaths(const std::vector<PointerPath*>& paths);
+bool ResolvePointerPath(PointerPath& path);
+//reverse pointer scan of all CC3.exe data memory for paths from the Title anchor to address
+//each pointer may point up to maxOffset bytes before what it leads to, paths rooted next to the anchor come first
+std::vector<PointerPath> FindPointerPaths(uint32_t address, uint32_t maxOffset, int maxDepth, std::size_t maxResults);
+
+//same order as the value types of the memory scanner
+enum class WatchType
+{
+	S8, U8, S16, U16, S32, U32, S64, U64, F32, F64
+};
+struct WatchEvent
+{
+	int Subscription; //as returned by Watch
+	uint32_t Address;
+	WatchType Type;
+	uint64_t Old; //raw bytes of the value, zero extended
+	uint64_t New;
+	std::chrono::steady_clock::time_point Time;
+};
+//count values spaced stride bytes apart share one subscription, e.g. the same field of every soldier
+//subscriptions can change while watching, values read for the first time produce no event
+int Watch(uint32_t address, WatchType type, std::size_t count = 1, std::size_t stride = 0);
+void Unwatch(int subscription);
+//polls all subscriptions rate times a second on a background thread, must be attached to CC3.exe
+void StartWatching(double rate);
+void StopWatching();
+//never blocks, events are dropped rather than stalling the poll thread if the bot falls behind
+bool PopWatchEvent(WatchEvent& event);
+uint64_t GetDroppedWatchEvents();
@@ -0,0 +1,181 @@
+#pragma once
+
+//reverse pointer scan shared by the bot (live CC3.exe memory) and BinExplorer (dumps)
+//every aligned 32-bit value that points into a scanned region is indexed by what it points at,
+//so "who points into [addr, addr+range)" is a binary search instead of a pass over all memory
+
+struct PointerScanRegion
+{
+	uint32_t Base; //address of Data[0] in the process
+	const uint8_t* Data;
+	std::size_t Size;
+};
+
+struct PointerReference
+{
+	uint32_t Target; //value stored at Location
+	uint32_t Location;
+
+	bool operator<(const PointerReference& rhs) const
+	{
+		return Target < rhs.Target || (Target == rhs.Target && Location < rhs.Location);
+	}
+};
+
+//a way to reach the scan target: start at Root, then repeatedly follow the pointer and add the next offset
+struct PointerChain
+{
+	uint32_t Root;
+	std::vector<int32_t> Offsets; //one per dereference, the last lands on the target
+};
+
+class PointerIndex
+{
+public:
+	//regions must stay alive while the index is built but not afterwards
+	void Build(const std::vector<PointerScanRegion>& regions)
+	{
+		_Ranges.clear();
+		for (const PointerScanRegion& region : regions)
+			_Ranges.emplace_back(region.Base, region.Base + static_cast<uint32_t>(region.Size));
+		std::sort(_Ranges.begin(), _Ranges.end());
+
+		//regions are handed out largest first so one huge heap doesn't end up last on a busy thread
+		std::vector<std::size_t> order(regions.size());
+		for (std::size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+		{
+			return regions[a].Size > regions[b].Size;
+		});
+
+		const unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<std::vector<PointerReference>> found(numThreads);
+		std::atomic<std::size_t> next(0);
+		auto work = [&](unsigned thread)
+		{
+			std::vector<PointerReference>& out = found[thread];
+			for (std::size_t i; (i = next++) < order.size(); )
+			{
+				const PointerScanRegion& region = regions[order[i]];
+				const uint32_t lead = (4 - (region.Base & 3)) & 3; //first aligned address
+				for (std::size_t offset = lead; offset + 4 <= region.Size; offset += 4)
+				{
+					uint32_t value;
+					std::memcpy(&value, region.Data + offset, 4);
+					if (IsInside(value))
+						out.push_back({ value, region.Base + static_cast<uint32_t>(offset) });
+				}
+			}
+			std::sort(out.begin(), out.end());
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 1; i < numThreads; ++i)
+			threads.emplace_back(work, i);
+		work(0);
+		for (std::thread& thread : threads)
+			thread.join();
+
+		//merge the sorted runs of each thread
+		_Entries.clear();
+		std::size_t total = 0;
+		for (const auto& part : found)
+			total += part.size();
+		_Entries.reserve(total);
+		for (auto& part : found)
+		{
+			const std::size_t middle = _Entries.size();
+			_Entries.insert(_Entries.end(), part.begin(), part.end());
+			std::vector<PointerReference>().swap(part);
+			std::inplace_merge(_Entries.begin(), _Entries.begin() + middle, _Entries.end());
+		}
+	}
+
+	std::size_t GetSize() const
+	{
+		return _Entries.size();
+	}
+
+	//calls func for every reference whose target is in [address, address + range)
+	template <typename FuncT>
+	void FindReferences(uint32_t address, uint32_t range, FuncT func) const
+	{
+		const PointerReference first = { address, 0 };
+		const uint64_t end = static_cast<uint64_t>(address) + range;
+		for (auto it = std::lower_bound(_Entries.cbegin(), _Entries.cend(), first); it != _Entries.cend() && it->Target < end; ++it)
+			func(*it);
+	}
+
+	//chains of at most maxDepth dereferences ending at target, each pointer may point up to maxOffset bytes before what it leads to
+	//breadth first so the shortest chains come out first, stops once maxResults are found
+	std::vector<PointerChain> FindChains(uint32_t target, uint32_t maxOffset, int maxDepth, std::size_t maxResults) const
+	{
+		return FindChains(target, maxOffset, maxDepth, maxResults, [](uint32_t) { return true; });
+	}
+
+	//as above, but chains with a root for which isPreferred(root) holds come first
+	//stops once maxResults preferred chains are found, or maxResults in all and the depth being searched is done,
+	//so a preferred chain isn't cut off by others of the same length found before it
+	template <typename IsPreferredFuncT>
+	std::vector<PointerChain> FindChains(uint32_t target, uint32_t maxOffset, int maxDepth, std::size_t maxResults, IsPreferredFuncT isPreferred) const
+	{
+		struct Node
+		{
+			uint32_t Location;
+			int32_t Offset; //added after dereferencing Location to reach the parent
+			std::size_t Parent;
+		};
+		constexpr std::size_t NoParent = std::numeric_limits<std::size_t>::max();
+
+		std::vector<PointerChain> chains; //preferred
+		std::vector<PointerChain> others; //at most maxResults
+		std::vector<Node> nodes = { { target, 0, NoParent } };
+		std::unordered_set<uint32_t> visited = { target };
+		std::size_t levelBegin = 0;
+		for (int depth = 1; depth <= maxDepth && chains.size() + others.size() < maxResults; ++depth)
+		{
+			const std::size_t levelEnd = nodes.size();
+			for (std::size_t parent = levelBegin; parent < levelEnd && chains.size() < maxResults; ++parent)
+			{
+				const uint32_t location = nodes[parent].Location;
+				const uint32_t low = location >= maxOffset ? location - maxOffset : 0;
+				FindReferences(low, location - low + 1, [&](const PointerReference& ref)
+				{
+					if (chains.size() >= maxResults)
+						return;
+					if (!visited.insert(ref.Location).second)
+						return; //already reachable with fewer dereferences
+
+					nodes.push_back({ ref.Location, static_cast<int32_t>(location - ref.Target), parent });
+					const bool preferred = isPreferred(ref.Location);
+					if (!preferred && others.size() >= maxResults)
+						return;
+
+					PointerChain chain;
+					chain.Root = ref.Location;
+					for (std::size_t n = nodes.size() - 1; nodes[n].Parent != NoParent; n = nodes[n].Parent)
+						chain.Offsets.push_back(nodes[n].Offset);
+					(preferred ? chains : others).push_back(std::move(chain));
+				});
+			}
+			levelBegin = levelEnd;
+		}
+
+		for (std::size_t i = 0; i < others.size() && chains.size() < maxResults; ++i)
+			chains.push_back(std::move(others[i]));
+		return chains;
+	}
+private:
+	std::vector<PointerReference> _Entries; //sorted by target
+	std::vector<std::pair<uint32_t, uint32_t>> _Ranges; //sorted [begin, end) of every scanned region
+
+	bool IsInside(uint32_t value) const
+	{
+		auto it = std::upper_bound(_Ranges.cbegin(), _Ranges.cend(), std::make_pair(value, std::numeric_limits<uint32_t>::max()));
+		if (it == _Ranges.cbegin())
+			return false;
+		--it;
+		return value < it->second;
+	}
+};
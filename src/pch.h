@@ -32,13 +32,18 @@
 #include <iostream>
 #include <iterator>
 #include <iphlpapi.h>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <objbase.h>
 #include <psapi.h>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <wchar.h>